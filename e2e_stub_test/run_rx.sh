@@ -13,5 +13,6 @@ rm log.bin
 touch log.bin
 pkill -9 binstub
 pkill -9 spawner
+# Stubbed channel 1 air interface: LoRa RX on udp 8002, LoRa TX to udp 8003
 ../pilorastubbed --channel=1 --cx=127.0.0.1:2000 --rx=127.0.0.1:3000 --carrier=433000000 --bandwidth=500 --coding-rate=4/5 --spreading-factor=SF7 --reset-pin=33 --txrx-done-pin=32 &
 ../spawner ../pilorastubbed.rodata log.bin noexiteof
\ No newline at end of file
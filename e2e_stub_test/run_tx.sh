@@ -10,5 +10,6 @@ rm log.bin
 touch log.bin
 pkill -9 binstub
 pkill -9 spawner
+# Stubbed channel 1 air interface: LoRa RX on udp 8002, LoRa TX to udp 8003
 ../binstub --channel=1 --cx=127.0.0.1:2001 --tx=127.0.0.1:3001 --carrier=433000000 --bandwidth=500 --coding-rate=4/5 --spreading-factor=SF7 --reset-pin=33 --txrx-done-pin=32 &
 ../spawner ../binstub.rodata log.bin noexiteof &
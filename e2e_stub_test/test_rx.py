@@ -3,7 +3,8 @@ import socket
 
 ADDR = "127.0.0.1"
 RX = 3000
-LORA_RX = 8000
+CHANNEL = 1 # --channel of the stub, see run_*.sh
+LORA_RX = 8000+2*CHANNEL
 lorarx = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
 rx = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
 
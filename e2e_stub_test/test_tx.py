@@ -3,7 +3,8 @@ import socket
 
 ADDR = "127.0.0.1"
 TX_PORT = 3001
-LORA_TX_PORT = 8001
+CHANNEL = 1 # --channel of the stub, see run_*.sh
+LORA_TX_PORT = 8001+2*CHANNEL
 
 txsock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
 loratxsock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
@@ -4,6 +4,8 @@
 #include <map>
 #include <memory>
 #include <thread>
+#include <mutex>
+#include <vector>
 #include <chrono>
 #include <hwapi/HwApi.hpp>
 #include <logless/Logger.hpp>
@@ -53,33 +55,65 @@ public:
 
     int registerCallback(unsigned pUserGpio, Edge pEdge, std::function<void(uint32_t tick)> pCb)
     {
-        cb = pCb;
-        Logless(mLogger, "DBG GpioStub::registerCallback registerCallback(_, _)", pUserGpio, (Edge::FALLING==pEdge? "FALLING" : "RISING"));
-        return 0;
+        std::unique_lock<std::mutex> lock(mMutex);
+        int id = mNextCallbackId++;
+        mCallbacks.emplace(id, std::make_pair(pUserGpio, std::move(pCb)));
+        Logless(mLogger, "DBG GpioStub::registerCallback registerCallback(_, _) id: _", pUserGpio, (Edge::FALLING==pEdge? "FALLING" : "RISING"), id);
+        return id;
     }
 
     int deregisterCallback(int pCallbackId)
     {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCallbacks.erase(pCallbackId);
         Logless(mLogger, "DBG GpioStub::deregisterCallback deregisterCallback(_)", pCallbackId); 
         return 0;
     }
 
-    std::function<void(uint32_t tick)> cb;
+    // Raises an edge on pGpio, the callbacks are called outside of the lock
+    void trigger(unsigned pGpio, uint32_t pTick)
+    {
+        std::vector<std::function<void(uint32_t tick)>> callbacks;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            for (auto& callback : mCallbacks)
+            {
+                if (callback.second.first == pGpio)
+                {
+                    callbacks.push_back(callback.second.second);
+                }
+            }
+        }
+        for (auto& callback : callbacks)
+        {
+            callback(pTick);
+        }
+    }
+
 private:
+    std::mutex mMutex;
+    std::map<int, std::pair<unsigned, std::function<void(uint32_t tick)>>> mCallbacks;
+    int mNextCallbackId = 1;
     Logger& mLogger;
 };
 
 std::shared_ptr<ISpi> getSpi(uint8_t pChannel);
 std::shared_ptr<IGpio> getGpio();
 
+// Stub board wiring: the DIO0 of SPI channel N is on gpio DIO0_GPIO_BASE+N
+constexpr unsigned DIO0_GPIO_BASE = 31;
+
 class Sx1278SpiStub : public ISpi
 {
 public:
     Sx1278SpiStub(int pChannel)
         : mChannel(pChannel)
+        , mDio0Pin(DIO0_GPIO_BASE+pChannel)
         , mLogger(Logger::getInstance())
+        , mTxDoneExecutor([this](){raiseDio0();})
     {
-        mSocket.bind(bfc::toIpPort(127,0,0,1, 8000));
+        // Every channel has its own air interface ports
+        mSocket.bind(bfc::toIpPort(127,0,0,1, 8000+2*pChannel));
         setValue(flylora_sx127x::REGVERSION, 0x12);
     }
 
@@ -113,6 +147,12 @@ public:
     }
 private:
 
+    void raiseDio0()
+    {
+        std::static_pointer_cast<GpioStub>(getGpio())->trigger(mDio0Pin,
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count());
+    }
+
     void loraRx()
     {
         timeval tv{};
@@ -152,7 +192,8 @@ private:
                 setValue(flylora_sx127x::REGRXNBBYTES, rc);
                 setValue(flylora_sx127x::REGFIFORXCURRENTADDR, fifoRxTop);
                 setValue(flylora_sx127x::REGFIFORXBYTEADDR, fifoRxTop+rc);
-                std::static_pointer_cast<GpioStub>(getGpio())->cb(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count());
+                setValue(flylora_sx127x::REGIRQFLAGS, getValue(flylora_sx127x::REGIRQFLAGS) | flylora_sx127x::RXDONEMASK);
+                raiseDio0();
             }
         }
     }
@@ -167,23 +208,38 @@ private:
             // throw std::runtime_error("WRITE WHILE NOT IN SLEEP OR STANDBY MODE!!");
         }
 
+        if (flylora_sx127x::REGFIFO == pReg)
+        {
+            auto fifoCount = pCount-1;
+            auto fifoIdx = getValue(flylora_sx127x::REGFIFOADDRPTR);
+            if (fifoIdx+pCount > 256)
+            {
+                throw std::runtime_error("FIFO OVERRUN!!");
+            }
+            Logless(mLogger, "DBG Sx1278SpiStub::regwrite FIFO WRITE[_]: _", fifoCount, BufferLog(fifoCount, pDataOut+1));
+            std::memcpy(mFifo+fifoIdx, pDataOut+1, fifoCount);
+            setValue(flylora_sx127x::REGFIFOADDRPTR, fifoIdx+fifoCount);
+            return;
+        }
+
+        // Burst access, address is automatically incremented after each byte
+        for (unsigned i=1; i<pCount; i++)
+        {
+            regwrite(uint8_t(pReg+i-1), pDataOut[i]);
+        }
+    }
+
+    void regwrite(uint8_t pReg, uint8_t pValue)
+    {
         // TODO: DATAIN VALIDATION
-        uint regVal = pDataOut[1];
         auto oldValue = getValue(pReg);
-        setValue(pReg, regVal);
+        setValue(pReg, pValue);
         switch (pReg)
         {
-            case flylora_sx127x::REGFIFO:
+            case flylora_sx127x::REGIRQFLAGS:
             {
-                auto fifoCount = pCount-1;
-                auto fifoIdx = getValue(flylora_sx127x::REGFIFOADDRPTR);
-                if (fifoIdx+pCount > 256)
-                {
-                    throw std::runtime_error("FIFO OVERRUN!!");
-                }
-                Logless(mLogger, "DBG Sx1278SpiStub::regwrite FIFO WRITE[_]: _", fifoCount, BufferLog(fifoCount, pDataOut+1));
-                std::memcpy(mFifo+fifoIdx, pDataOut+1, fifoCount);
-                setValue(flylora_sx127x::REGFIFOADDRPTR, fifoIdx+fifoCount);
+                // writing a 1 clears the IRQ
+                setValue(pReg, oldValue&(~pValue));
                 break;
             }
             case flylora_sx127x::REGOPMODE:
@@ -207,18 +263,10 @@ private:
                     // TODO: TX LEN FOR IMPLICIT HEADER MODE
                     auto txLen = getValue(flylora_sx127x::REGPAYLOADLENGTH);
                     bfc::BufferView data((std::byte*)(mFifo+fifoTxBase), txLen);
-                    mSocket.sendto(data, bfc::toIpPort(127,0,0,1,8001));
+                    mSocket.sendto(data, bfc::toIpPort(127,0,0,1,8001+2*mChannel));
+                    setValue(flylora_sx127x::REGIRQFLAGS, getValue(flylora_sx127x::REGIRQFLAGS) | flylora_sx127x::TXDONEMASK);
 
-
-                    static bfc::LightFn<void()> txDoneExecutor = []()
-                        {
-                            std::static_pointer_cast<GpioStub>(getGpio())->cb(
-                                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now()
-                                    .time_since_epoch())
-                                    .count());
-                        };
-
-                    mThreadPool.execute(txDoneExecutor);
+                    mThreadPool.execute(mTxDoneExecutor);
 
                     setValue(pReg, flylora_sx127x::Mode::STDBY, flylora_sx127x::MODEMASK);
                     Logless(mLogger, "DBG Sx1278SpiStub::regwrite ----- TRANSMISSION COMPLETED -----");
@@ -242,19 +290,23 @@ private:
             {
                 auto fifoCount = pCount-1;
                 auto fifoIdx = getValue(flylora_sx127x::REGFIFOADDRPTR);
-                if (fifoIdx+fifoCount > 256)
+                // FIFO address pointer wraps around the 256 bytes data buffer
+                for (unsigned i=0; i<fifoCount; i++)
                 {
-                    throw std::runtime_error("FIFO OVERRUN!!");
+                    pDataOut[1+i] = mFifo[uint8_t(fifoIdx+i)];
+                    pDataIn[1+i] = mFifo[uint8_t(fifoIdx+i)];
                 }
-                std::memcpy(pDataOut+1, mFifo+fifoIdx, fifoCount);
-                std::memcpy(pDataIn+1, mFifo+fifoIdx, fifoCount);
                 Logless(mLogger, "DBG Sx1278SpiStub::regread FIFO READ[_]@_: _", fifoCount, unsigned(fifoIdx), BufferLog(fifoCount, pDataOut+1));
                 setValue(flylora_sx127x::REGFIFOADDRPTR, fifoIdx+fifoCount);
                 break;
             }
             default:
             {
-                pDataIn[1] = getValue(pReg);
+                // Burst access, address is automatically incremented after each byte
+                for (unsigned i=1; i<pCount; i++)
+                {
+                    pDataIn[i] = getValue(uint8_t(pReg+i-1));
+                }
             }
 
         }; 
@@ -290,7 +342,9 @@ private:
     std::thread mLoRaRxThread;
     bool mLoRaRxActive;
     bfc::UdpSocket mSocket;
+    unsigned mDio0Pin;
     Logger& mLogger;
+    bfc::LightFn<void()> mTxDoneExecutor;
 
     bfc::ThreadPool<bfc::LightFn<void()>> mThreadPool;
 };
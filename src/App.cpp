@@ -3,10 +3,26 @@
 namespace app
 {
 
-Args::Args(const Options& pOptions)
+Args::Args(const Options& pOptions, int pRadio)
     : mOptions(pOptions)
+    , mRadio(pRadio)
 {}
 
+int Args::getRadio() const
+{
+    return mRadio;
+}
+
+int Args::getRadioCount() const
+{
+    int count = parseInt("radios", 1);
+    if (count < 1)
+    {
+        throw std::runtime_error(std::to_string(count) + " is invalid radio count");
+    }
+    return count;
+}
+
 int Args::getChannel() const
 {
     return parseInt("channel");
@@ -14,12 +30,13 @@ int Args::getChannel() const
 
 bfc::IpPort Args::getCtrlAddr() const
 {
-    return parseIpPort("cx", {0, 2221u});
+    // Each radio gets its own control port by default
+    return parseIpPort("cx", {0, uint16_t(2221u+std::max(mRadio, 0))});
 }
 
 bfc::IpPort Args::getIoAddr() const
 {
-    if (isTx())
+    if (isTx() || isHalfDuplex())
     {
         return parseIpPort("tx", {0, 0});
     }
@@ -40,11 +57,36 @@ bool Args::isTx() const
     return false;
 }
 
+bool Args::isHalfDuplex() const
+{
+    return parseIpPort("tx", {0, 0}).port != 0 && parseIpPort("rx", {0, 0}).port != 0;
+}
+
+bfc::IpPort Args::getRxAddr() const
+{
+    return parseIpPort("rx", {0, 0});
+}
+
 uint32_t Args::getCarrier() const
 {
     return parseUnsigned("carrier");
 }
 
+std::vector<uint64_t> Args::getHopCarriers() const
+{
+    return parseUnsignedList("hop-carriers");
+}
+
+int Args::getHopPeriod() const
+{
+    int period = parseInt("hop-period", 0);
+    if (period < 0 || period > 255)
+    {
+        throw std::runtime_error(std::to_string(period) + " is invalid hop period value");
+    }
+    return period;
+}
+
 flylora_sx127x::Bw Args::getBw() const
 {
     return parseBw("bandwidth");
@@ -62,12 +104,57 @@ flylora_sx127x::SpreadingFactor Args::getSf() const
 
 int Args::getMtu() const
 {
-    return parseInt("mtu", 0);
+    int mtu = parseInt("mtu", 0);
+    if (mtu < 0 || mtu > 255)
+    {
+        throw std::runtime_error(std::to_string(mtu) + " is invalid mtu value");
+    }
+    return mtu;
+}
+
+int Args::getPreambleLength() const
+{
+    int length = parseInt("preamble-length", 8);
+    if (length < 6 || length > 65535)
+    {
+        throw std::runtime_error(std::to_string(length) + " is invalid preamble length value");
+    }
+    return length;
+}
+
+int Args::getSyncWord() const
+{
+    return parseByte("sync-word", 0x12);
 }
 
 int Args::getTxPower() const
 {
-    return parseInt("tx-power", 17);
+    int power = parseInt("tx-power", 17);
+    if (power < 0 || power > 17)
+    {
+        throw std::runtime_error(std::to_string(power) + " is invalid tx power value");
+    }
+    return power;
+}
+
+bool Args::getPayloadCrc() const
+{
+    return parseOnOff("payload-crc", false);
+}
+
+flylora_sx127x::PaRamp Args::getPaRamp() const
+{
+    return parsePaRamp("pa-ramp");
+}
+
+bool Args::getWarmStandby() const
+{
+    return parseOnOff("warm-standby", false);
+}
+
+bool Args::getRxTimestamp() const
+{
+    return parseOnOff("rx-timestamp", false);
 }
 
 flylora_sx127x::LnaGain Args::getLnaGain() const
@@ -75,6 +162,17 @@ flylora_sx127x::LnaGain Args::getLnaGain() const
     return parseGain("rx-gain");
 }
 
+bool Args::getAgc() const
+{
+    auto it = find("rx-gain");
+    return it != mOptions.cend() && it->second == "auto";
+}
+
+bool Args::getLnaBoost() const
+{
+    return parseOnOff("lna-boost", false);
+}
+
 int Args::getResetPin() const
 {
     return parseInt("reset-pin");
@@ -85,9 +183,109 @@ int Args::getGetDio1Pin() const
     return parseInt("txrx-done-pin");
 }
 
+int Args::getDio3Pin() const
+{
+    return parseInt("valid-header-pin", -1);
+}
+
+int Args::getRxTimeoutPin() const
+{
+    return parseInt("rx-timeout-pin", -1);
+}
+
+int Args::getRxWindowSymbols() const
+{
+    int symbols = parseInt("rx-window-symbols", 0);
+    if (symbols < 0 || symbols > 1023)
+    {
+        throw std::runtime_error(std::to_string(symbols) + " is invalid rx window symbols value");
+    }
+    return symbols;
+}
+
+int Args::getRxWindowPeriod() const
+{
+    return parseInt("rx-window-period", 1000);
+}
+
+int Args::getRxQueueSize() const
+{
+    int size = parseInt("rx-queue-size", 32);
+    if (size < 1)
+    {
+        throw std::runtime_error(std::to_string(size) + " is invalid rx queue size value");
+    }
+    return size;
+}
+
+flylora_sx127x::OverflowPolicy Args::getRxOverflowPolicy() const
+{
+    return parseOverflowPolicy("rx-overflow");
+}
+
+int Args::getTxQueueSize() const
+{
+    int size = parseInt("tx-queue-size", 8);
+    if (size < 1)
+    {
+        throw std::runtime_error(std::to_string(size) + " is invalid tx queue size value");
+    }
+    return size;
+}
+
+int Args::getLbtWindow() const
+{
+    return parseInt("lbt-window", 0);
+}
+
+int Args::getLbtMaxWindow() const
+{
+    return parseInt("lbt-max-window", 64);
+}
+
+int Args::getLbtMaxAttempts() const
+{
+    return parseInt("lbt-max-attempts", 8);
+}
+
+flylora_sx127x::SX1278::IrqMode Args::getIrqMode() const
+{
+    return parseIrqMode("irq-mode");
+}
+
+int Args::getIrqCpu() const
+{
+    // irq-poll-cpu is the former name, from when only the poller was a driver thread
+    return parseInt("irq-cpu", parseInt("irq-poll-cpu", -1));
+}
+
+int Args::getIrqPriority() const
+{
+    int priority = parseInt("irq-priority", 0);
+    if (priority < 0 || priority > 99)
+    {
+        throw std::runtime_error(std::to_string(priority) + " is invalid irq priority value");
+    }
+    return priority;
+}
+
+Options::const_iterator Args::find(const std::string& pKey) const
+{
+    // A radio specific value (--radioN.key) takes precedence over the one shared by all radios
+    if (mRadio >= 0)
+    {
+        auto it = mOptions.find("radio" + std::to_string(mRadio) + "." + pKey);
+        if (it != mOptions.cend())
+        {
+            return it;
+        }
+    }
+    return mOptions.find(pKey);
+}
+
 uint32_t Args::parseUnsigned(std::string pKey) const
 {
-    auto it = mOptions.find(pKey);
+    auto it = find(pKey);
     if (it == mOptions.cend())
     {
         throw std::runtime_error(pKey + " option is missing!");
@@ -95,9 +293,26 @@ uint32_t Args::parseUnsigned(std::string pKey) const
     return std::stoul(it->second);
 }
 
+std::vector<uint64_t> Args::parseUnsignedList(std::string pKey) const
+{
+    std::vector<uint64_t> rv;
+    auto it = find(pKey);
+    if (it == mOptions.cend())
+    {
+        return rv;
+    }
+
+    std::regex itemFilter("[0-9]+");
+    for (auto i = std::sregex_iterator(it->second.begin(), it->second.end(), itemFilter); i != std::sregex_iterator(); i++)
+    {
+        rv.push_back(std::stoull(i->str()));
+    }
+    return rv;
+}
+
 int Args::parseInt(std::string pKey) const
 {
-    auto it = mOptions.find(pKey);
+    auto it = find(pKey);
     if (it == mOptions.cend())
     {
         throw std::runtime_error(pKey + " option is missing!");
@@ -107,7 +322,7 @@ int Args::parseInt(std::string pKey) const
 
 int Args::parseInt(std::string pKey, int pDefaultValue) const
 {
-    auto it = mOptions.find(pKey);
+    auto it = find(pKey);
     if (it == mOptions.cend())
     {
         return pDefaultValue;
@@ -115,11 +330,28 @@ int Args::parseInt(std::string pKey, int pDefaultValue) const
     return std::stoi(it->second);
 }
 
+uint8_t Args::parseByte(std::string pKey, uint8_t pDefaultValue) const
+{
+    auto it = find(pKey);
+    if (it == mOptions.cend())
+    {
+        return pDefaultValue;
+    }
+
+    // decimal or 0x prefixed hex
+    auto value = std::stoul(it->second, nullptr, 0);
+    if (value > 0xFF)
+    {
+        throw std::runtime_error(it->second + " is invalid " + pKey + " value");
+    }
+    return value;
+}
+
 bfc::IpPort Args::parseIpPort(std::string pKey, bfc::IpPort pDefault) const
 {
     std::regex addressFilter("([0-9]+)\\.([0-9]+)\\.([0-9]+)\\.([0-9]+):([0-9]+)");
     std::smatch match;
-    auto it = mOptions.find(pKey);
+    auto it = find(pKey);
     bfc::IpPort rv;
     if (it == mOptions.cend())
     {
@@ -150,7 +382,7 @@ bfc::IpPort Args::parseIpPort(std::string pKey, bfc::IpPort pDefault) const
 
 flylora_sx127x::Bw Args::parseBw(std::string pKey) const
 {
-    auto it = mOptions.find(pKey);
+    auto it = find(pKey);
     if (it == mOptions.cend())
     {
         return flylora_sx127x::Bw::BW_500_KHZ;
@@ -172,7 +404,7 @@ flylora_sx127x::Bw Args::parseBw(std::string pKey) const
 
 flylora_sx127x::CodingRate Args::parseCr(std::string pKey) const
 {
-    auto it = mOptions.find(pKey);
+    auto it = find(pKey);
     if (it == mOptions.cend())
     {
         return flylora_sx127x::CodingRate::CR_4V5;
@@ -188,7 +420,7 @@ flylora_sx127x::CodingRate Args::parseCr(std::string pKey) const
 
 flylora_sx127x::SpreadingFactor Args::parseSf(std::string pKey) const
 {
-    auto it = mOptions.find(pKey);
+    auto it = find(pKey);
     if (it == mOptions.cend())
     {
         return flylora_sx127x::SpreadingFactor::SF_7;
@@ -207,8 +439,8 @@ flylora_sx127x::SpreadingFactor Args::parseSf(std::string pKey) const
 
 flylora_sx127x::LnaGain Args::parseGain(std::string pKey) const
 {
-    auto it = mOptions.find(pKey);
-    if (it == mOptions.cend())
+    auto it = find(pKey);
+    if (it == mOptions.cend() || it->second == "auto")
     {
         return flylora_sx127x::LnaGain::G1;
     }
@@ -223,30 +455,127 @@ flylora_sx127x::LnaGain Args::parseGain(std::string pKey) const
     throw std::runtime_error(it->second + " is invalid lna gain value");
 }
 
+bool Args::parseOnOff(std::string pKey, bool pDefaultValue) const
+{
+    auto it = find(pKey);
+    if (it == mOptions.cend())
+    {
+        return pDefaultValue;
+    }
+
+    if (it->second == "on") return true;
+    if (it->second == "off") return false;
+
+    throw std::runtime_error(it->second + " is invalid " + pKey + " value");
+}
+
+flylora_sx127x::PaRamp Args::parsePaRamp(std::string pKey) const
+{
+    auto it = find(pKey);
+    if (it == mOptions.cend())
+    {
+        return flylora_sx127x::PaRamp::RAMP_40_US;
+    }
+
+    if (it->second == "3400") return flylora_sx127x::PaRamp::RAMP_3P4_MS;
+    if (it->second == "2000") return flylora_sx127x::PaRamp::RAMP_2_MS;
+    if (it->second == "1000") return flylora_sx127x::PaRamp::RAMP_1_MS;
+    if (it->second == "500")  return flylora_sx127x::PaRamp::RAMP_500_US;
+    if (it->second == "250")  return flylora_sx127x::PaRamp::RAMP_250_US;
+    if (it->second == "125")  return flylora_sx127x::PaRamp::RAMP_125_US;
+    if (it->second == "100")  return flylora_sx127x::PaRamp::RAMP_100_US;
+    if (it->second == "62")   return flylora_sx127x::PaRamp::RAMP_62_US;
+    if (it->second == "50")   return flylora_sx127x::PaRamp::RAMP_50_US;
+    if (it->second == "40")   return flylora_sx127x::PaRamp::RAMP_40_US;
+    if (it->second == "31")   return flylora_sx127x::PaRamp::RAMP_31_US;
+    if (it->second == "25")   return flylora_sx127x::PaRamp::RAMP_25_US;
+    if (it->second == "20")   return flylora_sx127x::PaRamp::RAMP_20_US;
+    if (it->second == "15")   return flylora_sx127x::PaRamp::RAMP_15_US;
+    if (it->second == "12")   return flylora_sx127x::PaRamp::RAMP_12_US;
+    if (it->second == "10")   return flylora_sx127x::PaRamp::RAMP_10_US;
+
+    throw std::runtime_error(it->second + " is invalid pa ramp value");
+}
+
+flylora_sx127x::OverflowPolicy Args::parseOverflowPolicy(std::string pKey) const
+{
+    auto it = find(pKey);
+    if (it == mOptions.cend())
+    {
+        return flylora_sx127x::OverflowPolicy::DROP_OLDEST;
+    }
+
+    if (it->second == "drop-oldest") return flylora_sx127x::OverflowPolicy::DROP_OLDEST;
+    if (it->second == "drop-newest") return flylora_sx127x::OverflowPolicy::DROP_NEWEST;
+
+    throw std::runtime_error(it->second + " is invalid rx overflow value");
+}
+
+flylora_sx127x::SX1278::IrqMode Args::parseIrqMode(std::string pKey) const
+{
+    auto it = find(pKey);
+    if (it == mOptions.cend())
+    {
+        return flylora_sx127x::SX1278::IrqMode::GPIO;
+    }
+
+    if (it->second == "gpio") return flylora_sx127x::SX1278::IrqMode::GPIO;
+    if (it->second == "poll") return flylora_sx127x::SX1278::IrqMode::POLL;
+    if (it->second == "thread") return flylora_sx127x::SX1278::IrqMode::THREAD;
+
+    throw std::runtime_error(it->second + " is invalid irq mode value");
+}
+
 App::App(bfc::IUdpFactory& pUdpFactory, const Args& pArgs)
-    : mChannel(pArgs.getChannel())
+    : mRadio(pArgs.getRadio())
+    , mChannel(pArgs.getChannel())
     , mCtrlAddr(pArgs.getCtrlAddr())
-    , mMode(pArgs.isTx()? Mode::TX : Mode::RX)
+    , mMode(pArgs.isHalfDuplex() ? Mode::TRX : pArgs.isTx()? Mode::TX : Mode::RX)
     , mIoAddr(pArgs.getIoAddr())
+    , mRxAddr(pArgs.getRxAddr())
     , mCarrier(pArgs.getCarrier())
+    , mHopCarriers(pArgs.getHopCarriers())
+    , mHopPeriod(pArgs.getHopPeriod())
     , mBw(pArgs.getBw())
     , mCr(pArgs.getCr())
     , mSf(pArgs.getSf())
     , mMtu(pArgs.getMtu())
+    , mPreambleLength(pArgs.getPreambleLength())
+    , mSyncWord(pArgs.getSyncWord())
     , mTxPower(pArgs.getTxPower())
+    , mPayloadCrc(pArgs.getPayloadCrc())
+    , mPaRamp(pArgs.getPaRamp())
+    , mWarmStandby(pArgs.getWarmStandby())
+    , mRxTimestamp(pArgs.getRxTimestamp())
     , mRxGain(pArgs.getLnaGain())
+    , mAgc(pArgs.getAgc())
+    , mLnaBoost(pArgs.getLnaBoost())
     , mResetPin(pArgs.getResetPin())
     , mDio1Pin(pArgs.getGetDio1Pin())
+    , mDio3Pin(pArgs.getDio3Pin())
+    , mRxTimeoutPin(pArgs.getRxTimeoutPin())
+    , mRxWindowSymbols(pArgs.getRxWindowSymbols())
+    , mRxWindowPeriod(pArgs.getRxWindowPeriod())
+    , mRxQueueSize(pArgs.getRxQueueSize())
+    , mRxOverflowPolicy(pArgs.getRxOverflowPolicy())
+    , mTxQueueSize(pArgs.getTxQueueSize())
+    , mLbtWindow(pArgs.getLbtWindow())
+    , mLbtMaxWindow(pArgs.getLbtMaxWindow())
+    , mLbtMaxAttempts(pArgs.getLbtMaxAttempts())
+    , mIrqMode(pArgs.getIrqMode())
+    , mIrqCpu(pArgs.getIrqCpu())
+    , mIrqPriority(pArgs.getIrqPriority())
     , mCtrlSock(pUdpFactory.create())
     , mIoSock(pUdpFactory.create())
     , mSpi(hwapi::getSpi(mChannel))
     , mGpio(hwapi::getGpio())
-    , mModule(*mSpi, *mGpio, mResetPin, mDio1Pin)
+    , mModule(*mSpi, *mGpio, mResetPin, mDio1Pin, mRxQueueSize, mRxOverflowPolicy, mTxQueueSize, mIrqMode, mIrqCpu, mDio3Pin, mRxTimeoutPin, mIrqPriority)
     , mLogger(Logger::getInstance())
 {
     Logless(mLogger, "INF App::App -------------- Parameters ---------------");
+    Logless(mLogger, "INF App::App radio:           _", mRadio);
     Logless(mLogger, "INF App::App channel:         _", mChannel);
-    Logless(mLogger, "INF App::App Mode:            _", ((const char*[]){"TX", "RX"})[int(mMode)]);
+    Logless(mLogger, "INF App::App Mode:            _", ((const char*[]){"TX", "RX", "TX/RX half-duplex"})[int(mMode)]);
     Logless(mLogger, "INF App::App Control Address: _._._._:_",
         ((mCtrlAddr.addr>>24)&0xFF),
         ((mCtrlAddr.addr>>16)&0xFF),
@@ -259,20 +588,47 @@ App::App(bfc::IUdpFactory& pUdpFactory, const Args& pArgs)
         ((mIoAddr.addr>>8)&0xFF),
         (mIoAddr.addr&0xFF),
         mIoAddr.port);
+    if (Mode::TRX == mMode)
+    {
+        Logless(mLogger, "INF App::App RX Address:      _._._._:_",
+            ((mRxAddr.addr>>24)&0xFF),
+            ((mRxAddr.addr>>16)&0xFF),
+            ((mRxAddr.addr>>8)&0xFF),
+            (mRxAddr.addr&0xFF),
+            mRxAddr.port);
+    }
     Logless(mLogger, "INF App::App Carrier:         _ Hz", mCarrier);
+    Logless(mLogger, "INF App::App Hop Channels:    _ every _ symbols", mHopCarriers.size(), mHopPeriod);
     Logless(mLogger, "INF App::App Bandwidth:       _ kHz", ((const char*[]){"7.8", "10.4", "15.6", "20.8", "31.25", "41.7", "62.5", "125", "250", "500",})[int(mBw)]);
     Logless(mLogger, "INF App::App Coding Rate:     _", ((const char*[]){0, "4/5", "4/6", "4/7", "4/8"})[int(mCr)]);
     Logless(mLogger, "INF App::App Spread Factor:   _", ((const char*[]){0,0,0,0,0,0,"SF6", "SF7", "SF8", "SF9", "SF10", "SF11", "SF12"})[int(mSf)]);
     Logless(mLogger, "INF App::App MTU:             _", mMtu);
+    Logless(mLogger, "INF App::App Preamble:        _ symbols", mPreambleLength);
+    Logless(mLogger, "INF App::App Sync Word:       _", mSyncWord);
     Logless(mLogger, "INF App::App Tx Power:        _", mTxPower);
-    Logless(mLogger, "INF App::App Rx Gain:         _", ((const char*[]){"", "G1", "G2", "G3", "G4", "G5", "G6"})[int(mRxGain)]);
+    Logless(mLogger, "INF App::App Payload CRC:     _", mPayloadCrc ? "on" : "off");
+    Logless(mLogger, "INF App::App PA Ramp:         _ us", ((const char*[]){"3400", "2000", "1000", "500", "250", "125", "100", "62", "50", "40", "31", "25", "20", "15", "12", "10"})[int(mPaRamp)]);
+    Logless(mLogger, "INF App::App Warm Standby:    _", mWarmStandby ? "on" : "off");
+    Logless(mLogger, "INF App::App Rx Timestamp:    _", mRxTimestamp ? "on" : "off");
+    Logless(mLogger, "INF App::App Rx Gain:         _", mAgc ? "auto" : ((const char*[]){"", "G1", "G2", "G3", "G4", "G5", "G6"})[int(mRxGain)]);
+    Logless(mLogger, "INF App::App LNA Boost:       _", mLnaBoost ? "on" : "off");
     Logless(mLogger, "INF App::App Reset Pin:       _", mResetPin);
     Logless(mLogger, "INF App::App TX/RX Done Pin:  _", mDio1Pin);
+    Logless(mLogger, "INF App::App Valid Hdr Pin:   _", mDio3Pin);
+    Logless(mLogger, "INF App::App Rx Timeout Pin:  _", mRxTimeoutPin);
+    Logless(mLogger, "INF App::App Rx Window:       _ symbols every _ ms", mRxWindowSymbols, mRxWindowPeriod);
+    Logless(mLogger, "INF App::App Rx Queue Size:   _", mRxQueueSize);
+    Logless(mLogger, "INF App::App Rx Overflow:     _", ((const char*[]){"drop-oldest", "drop-newest"})[int(mRxOverflowPolicy)]);
+    Logless(mLogger, "INF App::App Tx Queue Size:   _", mTxQueueSize);
+    Logless(mLogger, "INF App::App LBT Window:      _ to _ ms, _ attempts", mLbtWindow, mLbtMaxWindow, mLbtMaxAttempts);
+    Logless(mLogger, "INF App::App IRQ Mode:        _", ((const char*[]){"gpio", "poll", "thread"})[int(mIrqMode)]);
+    Logless(mLogger, "INF App::App IRQ CPU:         _", mIrqCpu);
+    Logless(mLogger, "INF App::App IRQ Priority:    _", mIrqPriority);
 
     Logger::getInstance().flush();
 
     mCtrlSock->bind(mCtrlAddr);
-    if (Mode::TX == mMode)
+    if (Mode::RX != mMode)
     {
         mIoSock->bind(mIoAddr);
     }
@@ -287,26 +643,52 @@ int App::run()
     Logless(mLogger, "DBG App::run Initializing LoRa module.");
     mModule.resetModule();
 
+    Logless(mLogger, "DBG App::run Configuring LoRa module...");
+    if (Mode::TRX == mMode)
+    {
+        mModule.setUsage(flylora_sx127x::SX1278::Usage::TRX);
+    }
+    else if (Mode::TX == mMode)
+    {
+        mModule.setUsage(flylora_sx127x::SX1278::Usage::TX);
+    }
+    else if (mRxWindowSymbols > 0)
+    {
+        mModule.setUsage(flylora_sx127x::SX1278::Usage::RXS);
+        mModule.setRxWindow(mRxWindowSymbols, std::chrono::milliseconds(mRxWindowPeriod));
+    }
+    else
+    {
+        mModule.setUsage(flylora_sx127x::SX1278::Usage::RXC);
+    }
+    mModule.configure(getModemParams());
+    mModule.setHopTable(mHopCarriers, mHopPeriod);
+    mModule.setListenBeforeTalk(std::chrono::milliseconds(mLbtWindow), std::chrono::milliseconds(mLbtMaxWindow), mLbtMaxAttempts);
+    mModule.setPaRamp(mPaRamp);
+    mModule.setWarmStandby(mWarmStandby);
+
     bool validated = false;
     for (int i=0; i<3; i++)
     {
-        Logless(mLogger, "DBG App::run Configuring LoRa module...");
-        mModule.setUsage(Mode::TX==mMode ? flylora_sx127x::SX1278::Usage::TX :
-            flylora_sx127x::SX1278::Usage::RXC);
-        mModule.setCarrier(mCarrier);
-        mModule.configureModem(mBw, mCr, false, mSf);
-        mModule.setOutputPower(mTxPower);
-        {
-            using namespace std::literals::chrono_literals;
-            std::this_thread::sleep_for(100ms); // sx1278 configuration grace period
-        }
-        if (mModule.validate())
+        mModule.commit();
+        auto validation = mModule.validate();
+        if (validation)
         {
             validated = true;
             Logless(mLogger, "INF App::run LoRa module configured!");
             break;
         }
-        Logless(mLogger, "ERR App::run Validation failed!");
+
+        for (auto& mismatch : validation.mismatches)
+        {
+            Logless(mLogger, "ERR App::run Validation failed! _ expected:_ actual:_",
+                flylora_sx127x::regIndexToString(mismatch.reg),
+                unsigned(mismatch.expected),
+                unsigned(mismatch.actual));
+        }
+
+        using namespace std::literals::chrono_literals;
+        std::this_thread::sleep_for(100ms); // sx1278 configuration grace period
     }
 
     if (!validated)
@@ -314,29 +696,173 @@ int App::run()
         throw std::runtime_error("LoRa module can't be configured!");
     }
 
+    logRxFrontEnd();
     Logger::getInstance().flush();
 
     mModule.start();
+    mCtrlReceiver = std::thread([this](){runCtrl();});
+
+    if (Mode::RX == mMode && mRxWindowSymbols > 0)
+    {
+        Logless(mLogger, "INF App::run RX windows of _ us every _ ms",
+            mModule.getRxWindowDuration().count(), mRxWindowPeriod);
+    }
 
     if (Mode::RX == mMode)
     {
         runRx();
     }
+    else if (Mode::TX == mMode)
+    {
+        runTx();
+    }
     else
     {
+        mModulelReceiver = std::thread([this](){runRx();});
         runTx();
     }
     return 0;
 }
 
+flylora_sx127x::ModemParams App::getModemParams() const
+{
+    flylora_sx127x::ModemParams params{};
+    params.carrier = mCarrier;
+    params.bandwidth = mBw;
+    params.codingRate = mCr;
+    params.spreadingFactor = mSf;
+    params.payloadCrc = mPayloadCrc;
+    params.implicitLength = mMtu;
+    params.preambleLength = mPreambleLength;
+    params.syncWord = mSyncWord;
+    params.txPower = mTxPower;
+    params.rxGain = mRxGain;
+    params.lnaBoost = mLnaBoost;
+    params.agc = mAgc;
+    return params;
+}
+
+void App::logRxFrontEnd()
+{
+    // With AGC on the device reports the gain picked by the loop
+    Logless(mLogger, "INF App::logRxFrontEnd LNA gain: _ agc: _ boost: _",
+        ((const char*[]){"", "G1", "G2", "G3", "G4", "G5", "G6", ""})[int(mModule.getCurrentLnaGain())],
+        mModule.isAgc() ? "on" : "off",
+        mLnaBoost ? "on" : "off");
+}
+
+void App::runCtrl()
+{
+    bfc::Buffer recvbuffer(new std::byte[256], 256);
+    bfc::BufferView recvbufferview(recvbuffer);
+    while (1)
+    {
+        bfc::IpPort src;
+        auto sz = mCtrlSock->recvfrom(recvbufferview, src);
+        if (sz < 2)
+        {
+            continue;
+        }
+
+        auto msg = (const uint8_t*)recvbufferview.data();
+        if (uint8_t(CtrlMsgId::RECONFIGURATION_REQUEST) == msg[0])
+        {
+            onReconfigurationRequest(msg, sz, src);
+        }
+        else
+        {
+            Logless(mLogger, "WRN App::runCtrl unknown message! msgId: _", unsigned(msg[0]));
+        }
+    }
+}
+
+void App::onReconfigurationRequest(const uint8_t* pMsg, size_t pSize, bfc::IpPort pSrc)
+{
+    // See README Control Messages, multi-byte fields are little endian
+    if (pSize < 2)
+    {
+        Logless(mLogger, "ERR App::onReconfigurationRequest truncated header! size: _", pSize);
+        return;
+    }
+
+    uint8_t response[7] = {uint8_t(CtrlMsgId::RECONFIGURATION_RESPONSE), pMsg[1], 1};
+    try
+    {
+        if (pSize < 11)
+        {
+            throw std::runtime_error("truncated reconfiguration request");
+        }
+
+        // Validated by the driver, the members follow the radio once it took the parameters
+        uint8_t rxGain = pMsg[7];
+        flylora_sx127x::ModemParams params = getModemParams();
+        params.bandwidth = flylora_sx127x::Bw(pMsg[2]);
+        params.codingRate = flylora_sx127x::CodingRate(pMsg[3]);
+        params.spreadingFactor = flylora_sx127x::SpreadingFactor(pMsg[4]);
+        params.implicitLength = pMsg[5];
+        params.txPower = int8_t(pMsg[6]);
+        params.preambleLength = pMsg[8] | (pMsg[9]<<8);
+        params.syncWord = pMsg[10];
+        params.agc = !rxGain;
+        if (rxGain)
+        {
+            params.rxGain = flylora_sx127x::LnaGain(rxGain);
+        }
+
+        auto switchover = mModule.reconfigure(params, true);
+
+        mBw = params.bandwidth;
+        mCr = params.codingRate;
+        mSf = params.spreadingFactor;
+        mMtu = params.implicitLength;
+        mTxPower = params.txPower;
+        mPreambleLength = params.preambleLength;
+        mSyncWord = params.syncWord;
+        mRxGain = params.rxGain;
+        mAgc = params.agc;
+
+        uint32_t switchoverUs = switchover.count();
+        response[2] = 0;
+        response[3] = switchoverUs&0xFF;
+        response[4] = (switchoverUs>>8)&0xFF;
+        response[5] = (switchoverUs>>16)&0xFF;
+        response[6] = (switchoverUs>>24)&0xFF;
+        Logless(mLogger, "INF App::onReconfigurationRequest reconfigured! trId: _ switchover: _ us", unsigned(pMsg[1]), switchoverUs);
+        logRxFrontEnd();
+    }
+    catch (std::exception& e)
+    {
+        Logless(mLogger, "ERR App::onReconfigurationRequest _ trId: _", e.what(), unsigned(pMsg[1]));
+    }
+
+    bfc::BufferView responseView((std::byte*)response, sizeof(response));
+    mCtrlSock->sendto(responseView, pSrc);
+}
+
 void App::runRx()
 {
     while (1)
     {
-        bfc::Buffer received = mModule.rx();
-        if (received.size())
+        flylora_sx127x::RxFrame received = mModule.rx();
+        if (received)
         {
-            mIoSock->sendto(received, mIoAddr);
+            // frame returns to the pool once sent
+            uint8_t* start = received->data();
+            size_t size = received->size;
+            if (mRxTimestamp)
+            {
+                // RX done on the monotonic clock in us, written in the slot headroom
+                uint64_t timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                    received->metadata.timestamp.time_since_epoch()).count();
+                start = received->prepend(sizeof(timestampUs));
+                size += sizeof(timestampUs);
+                for (size_t i=0; i<sizeof(timestampUs); i++)
+                {
+                    start[i] = (timestampUs>>(8*i))&0xFF;
+                }
+            }
+            bfc::BufferView data((std::byte*)start, size);
+            mIoSock->sendto(data, mRxAddr);
         }
     }
 }
@@ -349,7 +875,22 @@ void App::runTx()
     {
         bfc::IpPort src;
         auto sz = mIoSock->recvfrom(recvbufferview, src);
-        mModule.tx((uint8_t*)recvbufferview.data(), sz);
+        if (sz <= 0)
+        {
+            continue;
+        }
+
+        auto handle = mModule.submit((uint8_t*)recvbufferview.data(), sz, [this](const flylora_sx127x::TxResult& pResult){
+                if (flylora_sx127x::TxStatus::SENT != pResult.status)
+                {
+                    Logless(mLogger, "ERR App::runTx tx failed! handle: _ status: _", pResult.handle, flylora_sx127x::enumToString(pResult.status));
+                }
+            });
+
+        if (!handle)
+        {
+            Logless(mLogger, "ERR App::runTx tx rejected! size: _", sz);
+        }
     }
 }
 
@@ -13,35 +13,73 @@ namespace app
 
 using Options = std::map<std::string, std::string>;
 
+enum class CtrlMsgId : uint8_t {RECONFIGURATION_REQUEST = 1, RECONFIGURATION_RESPONSE = 2};
+
 class Args
 {
 public:
-    Args(const Options& pOptions);
+    // pRadio selects the options of one radio in multi-radio mode, -1 for a single radio
+    Args(const Options& pOptions, int pRadio = -1);
+    int getRadio() const;
+    int getRadioCount() const;
     int getChannel() const;
     bfc::IpPort getCtrlAddr() const;
     bfc::IpPort getIoAddr() const;
     bool isTx() const;
+    bool isHalfDuplex() const;
+    bfc::IpPort getRxAddr() const;
     uint32_t getCarrier() const;
+    std::vector<uint64_t> getHopCarriers() const;
+    int getHopPeriod() const;
     flylora_sx127x::Bw getBw() const;
     flylora_sx127x::CodingRate getCr() const;
     flylora_sx127x::SpreadingFactor getSf() const;
     int getMtu() const;
+    int getPreambleLength() const;
+    int getSyncWord() const;
     int getTxPower() const;
+    bool getPayloadCrc() const;
+    flylora_sx127x::PaRamp getPaRamp() const;
+    bool getWarmStandby() const;
+    bool getRxTimestamp() const;
     flylora_sx127x::LnaGain getLnaGain() const;
+    bool getAgc() const;
+    bool getLnaBoost() const;
     int getResetPin() const;
     int getGetDio1Pin() const;
+    int getDio3Pin() const;
+    int getRxTimeoutPin() const;
+    int getRxWindowSymbols() const;
+    int getRxWindowPeriod() const;
+    int getRxQueueSize() const;
+    flylora_sx127x::OverflowPolicy getRxOverflowPolicy() const;
+    int getTxQueueSize() const;
+    int getLbtWindow() const;
+    int getLbtMaxWindow() const;
+    int getLbtMaxAttempts() const;
+    flylora_sx127x::SX1278::IrqMode getIrqMode() const;
+    int getIrqCpu() const;
+    int getIrqPriority() const;
 
 private:
+    Options::const_iterator find(const std::string& pKey) const;
     uint32_t parseUnsigned(std::string pKey) const;
+    std::vector<uint64_t> parseUnsignedList(std::string pKey) const;
     int parseInt(std::string pKey) const;
     int parseInt(std::string pKey, int pDefaultValue) const;
+    uint8_t parseByte(std::string pKey, uint8_t pDefaultValue) const;
     bfc::IpPort parseIpPort(std::string pKey, bfc::IpPort pDefault) const;
     flylora_sx127x::Bw parseBw(std::string pKey) const;
     flylora_sx127x::CodingRate parseCr(std::string pKey) const;
     flylora_sx127x::SpreadingFactor parseSf(std::string pKey) const;
     flylora_sx127x::LnaGain parseGain(std::string pKey) const;
+    bool parseOnOff(std::string pKey, bool pDefaultValue) const;
+    flylora_sx127x::PaRamp parsePaRamp(std::string pKey) const;
+    flylora_sx127x::OverflowPolicy parseOverflowPolicy(std::string pKey) const;
+    flylora_sx127x::SX1278::IrqMode parseIrqMode(std::string pKey) const;
 
     const Options& mOptions;
+    int mRadio;
 };
 
 class App
@@ -53,21 +91,50 @@ public:
 private:
     void runRx();
     void runTx();
+    void runCtrl();
+    void onReconfigurationRequest(const uint8_t* pMsg, size_t pSize, bfc::IpPort pSrc);
+    flylora_sx127x::ModemParams getModemParams() const;
+    void logRxFrontEnd();
 
-    enum class Mode{TX, RX};
+    enum class Mode{TX, RX, TRX};
+    int mRadio;
     uint32_t mChannel;
     bfc::IpPort mCtrlAddr;
     Mode mMode;
     bfc::IpPort mIoAddr;
+    bfc::IpPort mRxAddr;
     uint32_t mCarrier;
+    std::vector<uint64_t> mHopCarriers;
+    int mHopPeriod;
     flylora_sx127x::Bw mBw;
     flylora_sx127x::CodingRate mCr;
     flylora_sx127x::SpreadingFactor mSf;
     int mMtu;
+    int mPreambleLength;
+    int mSyncWord;
     int mTxPower;
+    bool mPayloadCrc;
+    flylora_sx127x::PaRamp mPaRamp;
+    bool mWarmStandby;
+    bool mRxTimestamp;
     flylora_sx127x::LnaGain mRxGain;
+    bool mAgc;
+    bool mLnaBoost;
     int mResetPin;
     int mDio1Pin;
+    int mDio3Pin;
+    int mRxTimeoutPin;
+    int mRxWindowSymbols;
+    int mRxWindowPeriod;
+    int mRxQueueSize;
+    flylora_sx127x::OverflowPolicy mRxOverflowPolicy;
+    int mTxQueueSize;
+    int mLbtWindow;
+    int mLbtMaxWindow;
+    int mLbtMaxAttempts;
+    flylora_sx127x::SX1278::IrqMode mIrqMode;
+    int mIrqCpu;
+    int mIrqPriority;
     std::unique_ptr<bfc::ISocket> mCtrlSock;
     std::unique_ptr<bfc::ISocket> mIoSock;
     std::shared_ptr<hwapi::ISpi>  mSpi;
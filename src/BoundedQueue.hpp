@@ -0,0 +1,148 @@
+#ifndef __BOUNDEDQUEUE_HPP__
+#define __BOUNDEDQUEUE_HPP__
+
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <type_traits>
+#include <EventFd.hpp>
+
+namespace flylora_sx127x
+{
+
+enum class OverflowPolicy {DROP_OLDEST, DROP_NEWEST};
+
+// Bounded lock-free single producer/single consumer ring. On overflow the
+// producer either evicts the oldest element or drops the new one, it never
+// waits for the consumer. The consumer only sleeps on the eventfd when the
+// ring is empty so the producer skips the wakeup syscall while it is busy.
+template <typename T>
+class BoundedQueue
+{
+    static_assert(std::is_trivially_copyable<T>::value, "BoundedQueue element must be trivially copyable");
+public:
+    BoundedQueue(size_t pCapacity, OverflowPolicy pPolicy)
+        : mCapacity(pCapacity)
+        , mPolicy(pPolicy)
+        , mCells(new std::atomic<T>[pCapacity])
+    {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // pOnDrop is called with the element that did not make it to the queue
+    template <typename F>
+    void push(T pValue, F&& pOnDrop)
+    {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        while (true)
+        {
+            size_t head = mHead.load(std::memory_order_acquire);
+            if (tail-head < mCapacity)
+            {
+                break;
+            }
+
+            if (OverflowPolicy::DROP_NEWEST == mPolicy)
+            {
+                mDropCount.fetch_add(1, std::memory_order_relaxed);
+                pOnDrop(pValue);
+                return;
+            }
+
+            // evicting competes with pop() on the head index
+            T oldest = mCells[head%mCapacity].load(std::memory_order_relaxed);
+            if (mHead.compare_exchange_weak(head, head+1, std::memory_order_acq_rel))
+            {
+                mDropCount.fetch_add(1, std::memory_order_relaxed);
+                pOnDrop(oldest);
+                break;
+            }
+        }
+
+        mCells[tail%mCapacity].store(pValue, std::memory_order_relaxed);
+        mTail.store(tail+1, std::memory_order_release);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mSleeping.load(std::memory_order_relaxed))
+        {
+            mEvent.notify();
+        }
+    }
+
+    bool pop(T& pValue)
+    {
+        size_t head = mHead.load(std::memory_order_acquire);
+        while (head != mTail.load(std::memory_order_acquire))
+        {
+            T value = mCells[head%mCapacity].load(std::memory_order_relaxed);
+            if (mHead.compare_exchange_weak(head, head+1, std::memory_order_acq_rel))
+            {
+                pValue = value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool pop(T& pValue, std::chrono::milliseconds pTimeout)
+    {
+        auto deadline = std::chrono::steady_clock::now() + pTimeout;
+        while (!pop(pValue))
+        {
+            mSleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (pop(pValue))
+            {
+                mSleeping.store(false, std::memory_order_relaxed);
+                return true;
+            }
+
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            bool notified = remaining.count() > 0 && mEvent.wait(remaining);
+            mSleeping.store(false, std::memory_order_relaxed);
+            if (!notified || mInterrupted.exchange(false))
+            {
+                return pop(pValue);
+            }
+        }
+        return true;
+    }
+
+    // Wakes up a waiting consumer
+    void interrupt()
+    {
+        mInterrupted = true;
+        mEvent.notify();
+    }
+
+    size_t size() const
+    {
+        return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const
+    {
+        return mCapacity;
+    }
+
+    size_t getDropCount() const
+    {
+        return mDropCount.load(std::memory_order_relaxed);
+    }
+
+private:
+    size_t mCapacity;
+    OverflowPolicy mPolicy;
+    std::unique_ptr<std::atomic<T>[]> mCells;
+    std::atomic<size_t> mHead{};
+    std::atomic<size_t> mTail{};
+    std::atomic<size_t> mDropCount{};
+    std::atomic<bool> mSleeping{};
+    std::atomic<bool> mInterrupted{};
+    EventFd mEvent;
+};
+
+} // flylora_sx127x
+
+#endif // __BOUNDEDQUEUE_HPP__
\ No newline at end of file
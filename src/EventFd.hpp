@@ -0,0 +1,70 @@
+#ifndef __EVENTFD_HPP__
+#define __EVENTFD_HPP__
+
+#include <chrono>
+#include <stdexcept>
+#include <cstdint>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+
+namespace flylora_sx127x
+{
+
+// Thin eventfd wrapper, notify() never blocks so it is safe on the interrupt path
+class EventFd
+{
+public:
+    EventFd()
+        : mFd(eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC))
+    {
+        if (mFd < 0)
+        {
+            throw std::runtime_error("EventFd::EventFd eventfd failed!");
+        }
+    }
+
+    ~EventFd()
+    {
+        close(mFd);
+    }
+
+    EventFd(const EventFd&) = delete;
+    EventFd& operator=(const EventFd&) = delete;
+
+    void notify()
+    {
+        uint64_t one = 1;
+        ssize_t rc = ::write(mFd, &one, sizeof(one));
+        (void) rc;
+    }
+
+    // Returns the accumulated notification count, 0 on timeout
+    uint64_t wait(std::chrono::milliseconds pTimeout)
+    {
+        pollfd pfd{mFd, POLLIN, 0};
+        if (poll(&pfd, 1, pTimeout.count()) <= 0)
+        {
+            return 0;
+        }
+
+        uint64_t count = 0;
+        if (::read(mFd, &count, sizeof(count)) != sizeof(count))
+        {
+            return 0;
+        }
+        return count;
+    }
+
+    int fd() const
+    {
+        return mFd;
+    }
+
+private:
+    int mFd;
+};
+
+} // flylora_sx127x
+
+#endif // __EVENTFD_HPP__
\ No newline at end of file
@@ -0,0 +1,140 @@
+#ifndef __FRAMEPOOL_HPP__
+#define __FRAMEPOOL_HPP__
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+namespace flylora_sx127x
+{
+
+// Fixed capacity pool of preallocated slots, acquire and release are lock-free
+// and can be done from different threads.
+template <typename T>
+class FramePool
+{
+public:
+    class Frame
+    {
+    public:
+        Frame() = default;
+
+        Frame(Frame&& pOther)
+            : mPool(pOther.mPool)
+            , mIndex(pOther.mIndex)
+        {
+            pOther.mPool = nullptr;
+        }
+
+        Frame& operator=(Frame&& pOther)
+        {
+            if (this != &pOther)
+            {
+                release();
+                mPool = pOther.mPool;
+                mIndex = pOther.mIndex;
+                pOther.mPool = nullptr;
+            }
+            return *this;
+        }
+
+        Frame(const Frame&) = delete;
+        Frame& operator=(const Frame&) = delete;
+
+        ~Frame()
+        {
+            release();
+        }
+
+        explicit operator bool() const
+        {
+            return mPool;
+        }
+
+        T& operator*() const
+        {
+            return mPool->mSlots[mIndex];
+        }
+
+        T* operator->() const
+        {
+            return &mPool->mSlots[mIndex];
+        }
+
+        // Gives up ownership without returning the slot, see FramePool::adopt
+        size_t detach()
+        {
+            mPool = nullptr;
+            return mIndex;
+        }
+
+        void release()
+        {
+            if (mPool)
+            {
+                mPool->mInUse[mIndex].store(false, std::memory_order_release);
+                mPool = nullptr;
+            }
+        }
+
+    private:
+        friend class FramePool;
+
+        Frame(FramePool* pPool, size_t pIndex)
+            : mPool(pPool)
+            , mIndex(pIndex)
+        {}
+
+        FramePool* mPool = nullptr;
+        size_t mIndex = 0;
+    };
+
+    FramePool(size_t pCapacity)
+        : mCapacity(pCapacity)
+        , mSlots(new T[pCapacity]{})
+        , mInUse(new std::atomic<bool>[pCapacity])
+    {
+        for (size_t i=0; i<mCapacity; i++)
+        {
+            mInUse[i].store(false, std::memory_order_relaxed);
+        }
+    }
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    Frame acquire()
+    {
+        size_t start = mCursor.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i=0; i<mCapacity; i++)
+        {
+            size_t index = (start+i)%mCapacity;
+            if (!mInUse[index].exchange(true, std::memory_order_acquire))
+            {
+                return Frame(this, index);
+            }
+        }
+        return {};
+    }
+
+    // Takes back ownership of a detached slot
+    Frame adopt(size_t pIndex)
+    {
+        return Frame(this, pIndex);
+    }
+
+    size_t capacity() const
+    {
+        return mCapacity;
+    }
+
+private:
+    size_t mCapacity;
+    std::unique_ptr<T[]> mSlots;
+    std::unique_ptr<std::atomic<bool>[]> mInUse;
+    std::atomic<size_t> mCursor{};
+};
+
+} // flylora_sx127x
+
+#endif // __FRAMEPOOL_HPP__
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef __REALTIME_HPP__
+#define __REALTIME_HPP__
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace flylora_sx127x
+{
+
+// Pins the calling thread to a single cpu
+inline bool setCurrentThreadAffinity(int pCpu)
+{
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(pCpu, &cpuset);
+    return 0 == pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+}
+
+// Moves the calling thread to SCHED_FIFO at pPriority (1 to 99), needs CAP_SYS_NICE
+inline bool setCurrentThreadPriority(int pPriority)
+{
+    sched_param param{};
+    param.sched_priority = pPriority;
+    return 0 == pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+}
+
+} // flylora_sx127x
+
+#endif // __REALTIME_HPP__
\ No newline at end of file
@@ -2,26 +2,200 @@
 #define __SX1278_HPP__
 
 #include <thread>
+#include <mutex>
 #include <SX127x.hpp>
+#include <FramePool.hpp>
+#include <BoundedQueue.hpp>
+#include <Timer.hpp>
+#include <RealTime.hpp>
 #include <hwapi/HwApi.hpp>
-#include <condition_variable>
 #include <atomic>
 #include <cstring>
-#include <deque>
+#include <bitset>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <random>
+#include <array>
 #include <bfc/Buffer.hpp>
 #include <logless/Logger.hpp>
 
 namespace flylora_sx127x
 {
 
+struct RegisterMismatch
+{
+    uint8_t reg;
+    uint8_t expected;
+    uint8_t actual;
+};
+
+struct RxHeader
+{
+    uint32_t tick;          // gpio tick of ValidHeader, 0 without the valid header line
+    uint8_t size;           // payload length declared in the header
+    CodingRate codingRate;  // coding rate declared in the header
+    bool crcOn;             // payload CRC declared in the header
+};
+
+struct RxMetadata
+{
+    double getSnr() const
+    {
+        // 5.5.5.  RSSI and SNR in LoRa Mode - SX1276/77/78/79 DATASHEET
+        return snr/4.0;
+    }
+
+    int getRssi() const
+    {
+        // 5.5.5.  RSSI and SNR in LoRa Mode - SX1276/77/78/79 DATASHEET
+        return -164+rssi;
+    }
+
+    uint8_t irqFlags;
+    uint8_t size;
+    uint16_t headerCount;
+    uint16_t packetCount;
+    uint8_t modemStat;
+    int8_t snr;
+    uint8_t rssi;
+    RxHeader header;
+    uint32_t tick;                                      // gpio tick of RX done
+    std::chrono::steady_clock::time_point timestamp;    // RX done on the monotonic clock
+};
+
+struct RxFrameSlot
+{
+    // Room in front of the payload, a header can be prepended without moving it
+    static constexpr size_t HEADROOM = 8;
+
+    uint8_t* data()
+    {
+        return raw+HEADROOM+1;
+    }
+
+    // Start of the frame extended by pSize bytes (up to HEADROOM) to the front
+    uint8_t* prepend(size_t pSize)
+    {
+        return data()-pSize;
+    }
+
+    // FIFO is read directly into the slot, raw[HEADROOM] receives the SPI address byte
+    uint8_t raw[HEADROOM+1+256];
+    size_t size;
+    RxMetadata metadata;
+};
+
+using RxFramePool = FramePool<RxFrameSlot>;
+using RxFrame = RxFramePool::Frame;
+
+enum class TxStatus {SENT, TIMEOUT, ABORTED, CHANNEL_BUSY};
+
+inline const char* enumToString(TxStatus pVal)
+{
+    switch (pVal)
+    {
+        case TxStatus::SENT:
+            return "SENT";
+        case TxStatus::TIMEOUT:
+            return "TIMEOUT";
+        case TxStatus::ABORTED:
+            return "ABORTED";
+        case TxStatus::CHANNEL_BUSY:
+            return "CHANNEL_BUSY";
+        default:
+            return "INVALID!";
+    }
+}
+
+using TxHandle = uint32_t;
+
+struct TxResult
+{
+    TxHandle handle;
+    TxStatus status;
+    uint32_t tick;                      // gpio tick of TX done
+    std::chrono::microseconds airtime;  // TX mode entry to TX done
+    std::chrono::microseconds latency;  // submit to TX done
+    std::chrono::steady_clock::time_point timestamp;    // TX done on the monotonic clock, completion time otherwise
+};
+
+using TxCallback = std::function<void(const TxResult&)>;
+
+struct TxFrameSlot
+{
+    uint8_t* data()
+    {
+        return raw+1;
+    }
+
+    // FIFO is written directly from the slot, raw[0] holds the SPI address byte
+    uint8_t raw[1+256];
+    size_t size;
+    TxHandle handle;
+    TxCallback callback;
+    std::chrono::steady_clock::time_point txStart;
+    std::chrono::steady_clock::time_point enqueued;
+};
+
+using TxFramePool = FramePool<TxFrameSlot>;
+using TxFrame = TxFramePool::Frame;
+
+struct ModemParams
+{
+    uint64_t carrier;                   // ignored while hopping, see SX1278::setHopTable
+    Bw bandwidth;
+    CodingRate codingRate;
+    SpreadingFactor spreadingFactor;
+    bool payloadCrc;
+    uint8_t implicitLength;             // 0 for explicit header
+    uint16_t preambleLength;
+    uint8_t syncWord;
+    int8_t txPower;
+    LnaGain rxGain = LnaGain::G1;       // ignored with agc
+    bool lnaBoost = false;              // 150% LNA current on RFI_HF
+    bool agc = false;                   // LNA gain set by the AGC loop
+};
+
+struct ValidationResult
+{
+    explicit operator bool() const
+    {
+        return mismatches.empty();
+    }
+
+    std::vector<RegisterMismatch> mismatches;
+};
+
 class SX1278
 {
 public:
-    enum class Usage {UNSPEC, TX , RXC};
+    // TRX: half-duplex, RX continuous between TX frames
+    enum class Usage {UNSPEC, TX , RXC, RXS, TRX};
+    // GPIO: DIO1 edge callback, POLL: REGIRQFLAGS is polled over SPI from a dedicated thread,
+    // THREAD: edge callbacks only post the tick, the handlers run on a driver owned thread
+    enum class IrqMode {GPIO, POLL, THREAD};
+    // Half-duplex splits the FIFO in two, frames of both directions are limited to one half
+    static constexpr uint8_t HALF_DUPLEX_MTU = 128;
+    // 6.4.    LoRa Mode Register Map - SX1276/77/78/79 DATASHEET
+    // RegPayloadLength is 8 bits wide
+    static constexpr size_t MAX_PAYLOAD_LENGTH = 255;
 
-    SX1278(hwapi::ISpi& pSpi, hwapi::IGpio& pGpio, unsigned pResetPin, unsigned pDio1Pin)
-        : mResetPin(pResetPin)
+    SX1278(hwapi::ISpi& pSpi, hwapi::IGpio& pGpio, unsigned pResetPin, unsigned pDio1Pin,
+        size_t pRxQueueSize = 32, OverflowPolicy pRxOverflowPolicy = OverflowPolicy::DROP_OLDEST,
+        size_t pTxQueueSize = 8, IrqMode pIrqMode = IrqMode::GPIO, int pIrqCpu = -1,
+        int pDio3Pin = -1, int pRxTimeoutPin = -1, int pIrqPriority = 0)
+        : mRxPool(pRxQueueSize+2) // +1 being received, +1 being sent
+        , mRxQueue(pRxQueueSize, pRxOverflowPolicy)
+        , mTxPool(pTxQueueSize+1) // +1 being transmitted
+        , mTxQueue(pTxQueueSize, OverflowPolicy::DROP_NEWEST)
+        , mIrqQueue(IRQ_QUEUE_SIZE, OverflowPolicy::DROP_NEWEST)
+        , mResetPin(pResetPin)
         , mDio1Pin(pDio1Pin)
+        , mDio3Pin(pDio3Pin)
+        , mRxTimeoutPin(pRxTimeoutPin)
+        , mIrqMode(pIrqMode)
         , mSpi(pSpi)
         , mGpio(pGpio)
         , mLogger(Logger::getInstance())
@@ -29,15 +203,60 @@ public:
         mGpio.setMode(pResetPin, hwapi::PinMode::OUTPUT);
         mGpio.setMode(pDio1Pin,  hwapi::PinMode::INPUT);
         mGpio.set(mResetPin, 1);
-        mDio1CbId = mGpio.registerCallback(mDio1Pin, hwapi::Edge::RISING, [this](uint32_t){onDio1();});
+        if (IrqMode::POLL != mIrqMode)
+        {
+            mDio1CbId = mGpio.registerCallback(mDio1Pin, hwapi::Edge::RISING, [this](uint32_t pTick){postIrq(IrqLine::TXRX_DONE, pTick);});
+        }
+        if (mDio3Pin >= 0)
+        {
+            mGpio.setMode(mDio3Pin, hwapi::PinMode::INPUT);
+            mDio3CbId = mGpio.registerCallback(mDio3Pin, hwapi::Edge::RISING, [this](uint32_t pTick){postIrq(IrqLine::VALID_HEADER, pTick);});
+        }
+        if (mRxTimeoutPin >= 0)
+        {
+            mGpio.setMode(mRxTimeoutPin, hwapi::PinMode::INPUT);
+            mRxTimeoutCbId = mGpio.registerCallback(mRxTimeoutPin, hwapi::Edge::RISING, [this](uint32_t pTick){postIrq(IrqLine::RX_TIMEOUT, pTick);});
+        }
         init();
+        if (IrqMode::POLL == mIrqMode)
+        {
+            mIrqThread = std::thread([this, pIrqCpu, pIrqPriority](){runIrqPoller(pIrqCpu, pIrqPriority);});
+        }
+        else if (IrqMode::THREAD == mIrqMode)
+        {
+            mIrqThread = std::thread([this, pIrqCpu, pIrqPriority](){runIrqWorker(pIrqCpu, pIrqPriority);});
+        }
     }
 
     ~SX1278()
     {
-        mGpio.deregisterCallback(mDio1CbId);
+        if (IrqMode::POLL != mIrqMode)
+        {
+            mGpio.deregisterCallback(mDio1CbId);
+        }
+        if (mDio3Pin >= 0)
+        {
+            mGpio.deregisterCallback(mDio3CbId);
+        }
+        if (mRxTimeoutPin >= 0)
+        {
+            mGpio.deregisterCallback(mRxTimeoutCbId);
+        }
         mTeardown = true;
-        mRxTxDoneCv.notify_one();
+        mIrqQueue.interrupt();
+        if (mIrqThread.joinable())
+        {
+            mIrqThread.join();
+        }
+        mTxWatchdog.cancel();
+        mRxWindowTimer.cancel();
+        mTxSpace.notify();
+        mRxQueue.interrupt();
+        Logless(mLogger, "INF SX1278::~SX1278 rx received: _ crc error: _", getRxFrameCount(), getRxCrcErrorCount());
+        Logless(mLogger, "INF SX1278::~SX1278 cad: _ busy: _", getCadCount(), getCadBusyCount());
+        Logless(mLogger, "INF SX1278::~SX1278 tx sent: _ average latency: _ us", mTxSentCount.load(), int64_t(getAverageTxLatency().count()));
+        Logless(mLogger, "INF SX1278::~SX1278 rx dropped overflow: _ pool exhausted: _", getRxDropCount(), mRxPoolDropCount.load());
+        Logless(mLogger, "INF SX1278::~SX1278 irq dropped: _", mIrqQueue.getDropCount());
     }
 
     void resetModule()
@@ -55,14 +274,16 @@ public:
     void setUsage(Usage pUsage)
     {
         mUsage = pUsage;
-        // 4.1.6.1.  Digital IO Pin Mapping - SX1276/77/78/79 DATASHEET
-        if (Usage::TX == mUsage)
-        {
-            setRegister(REGDIOMAPPING1, DIO0TXDONEMASK);
-        }
-        else
+        setShadow(REGDIOMAPPING1, getDioMapping(Usage::TX == mUsage ? DIO0TXDONEMASK : DIO0RXDONEMASK));
+
+        // 4.1.2.3.  LoRa Mode FIFO Data Buffer - SX1276/77/78/79 DATASHEET
+        // Half-duplex loads TX frames in the upper half while RX keeps the lower one, longer
+        // headers are rejected by the modem so a reception can't overrun a loaded frame.
+        bool isSplit = Usage::TRX == mUsage;
+        setShadow(REGFIFOTXBASEADD, isSplit ? HALF_DUPLEX_MTU : 0);
+        if (isSplit || mValid[REGMAXPAYLOADLENGTH])
         {
-            setRegister(REGDIOMAPPING1, DIO0RXDONEMASK);
+            setShadow(REGMAXPAYLOADLENGTH, isSplit ? HALF_DUPLEX_MTU : 0xFF);
         }
     }
 
@@ -72,29 +293,56 @@ public:
         // 6.4.    LoRa Mode Register Map - SX1276/77/78/79 DATASHEET
         // TODO: DO SPURRIOUS OPTIMIZATION - SX1276/77/78 Errata fixes
         // TODO: DO DetectionOptimize - SX1276/77/78 Errata fixes
-        pCf = (pCf*524288ul)/mFosc;
+        auto frf = getFrf(pCf);
+
+        // Frequency change takes effect on RegFrLsb write, commit bursts MSB->LSB keeping it last
+        setShadow(REGFRMSB, frf[0]);
+        setShadow(REGFRMID, frf[1]);
+        setShadow(REGFRLSB, frf[2]);
+    }
 
-        mFrLsb = pCf&0xFF;
-        mFrMid = (pCf>>8)&0xFF;
-        mFrMsb = (pCf>>16)&0xFF;
+    // FHSS: the carrier hops through pCarriers every pHopPeriod symbols, each packet starts on
+    // pCarriers[0] which becomes the configured carrier. An empty table or zero period disables it.
+    void setHopTable(const std::vector<uint64_t>& pCarriers, uint8_t pHopPeriod)
+    {
+        // 4.1.1.8. Frequency Hopping in LoRa Mode - SX1276/77/78/79 DATASHEET
+        // FhssChangeChannel is raised on DIO1, without the line only the poller sees it
+        if (pHopPeriod && !pCarriers.empty() && mRxTimeoutPin < 0 && IrqMode::POLL != mIrqMode)
+        {
+            throw std::runtime_error("SX1278::setHopTable hopping requires the DIO1 line or IrqMode::POLL!");
+        }
+        mHopTable.clear();
+        if (pHopPeriod)
+        {
+            for (auto carrier : pCarriers)
+            {
+                mHopTable.push_back(getFrf(carrier));
+            }
+        }
+        mHopIndex = 0;
 
-        setRegister(REGFRLSB, mFrLsb);
-        setRegister(REGFRMID, mFrMid);
-        setRegister(REGFRMSB, mFrMsb);
+        if (isHopping())
+        {
+            setCarrier(pCarriers[0]);
+        }
+        setShadow(REGHOPPERIOD, isHopping() ? pHopPeriod : 0);
+        setUsage(mUsage);
     }
 
     uint32_t getCarrier()
     {
         // 4.1.4.  Frequency Settings - SX1276/77/78/79 DATASHEET
         // 6.4.    LoRa Mode Register Map - SX1276/77/78/79 DATASHEET
+        uint8_t frf[3];
+        readShadowed(REGFRMSB, frf, sizeof(frf));
         uint64_t cf = 0;
-        cf |= getRegister(REGFRLSB);
-        cf |= getRegister(REGFRMID)<<8;
-        cf |= getRegister(REGFRMSB)<<16;
+        cf |= frf[2];
+        cf |= frf[1]<<8;
+        cf |= frf[0]<<16;
         return (mFosc*cf)/524288;
     }
 
-    void configureModem(Bw pBandwidth, CodingRate pCodingRate, bool implicitHeader, SpreadingFactor pSpreadingFactor)
+    void configureModem(Bw pBandwidth, CodingRate pCodingRate, bool implicitHeader, SpreadingFactor pSpreadingFactor, bool payloadCrc = false)
     {
         // 4.1.1. Link Design Using the LoRa Modem - SX1276/77/78/79 DATASHEET
         // 6.4.   LoRa Mode Register Map - SX1276/77/78/79 DATASHEET
@@ -103,19 +351,95 @@ public:
             implicitHeader = true;
         }
 
-        uint8_t config1 = setMasked(BWMASK, uint8_t(pBandwidth))
-                        | setMasked(CODINGRATEMASK, uint8_t(pCodingRate))
-                        | setMasked(IMPLICITHEADERMODEONMASK, implicitHeader);
-        uint8_t config2 = setMasked(SPREADINGFACTORMASK, uint8_t(pSpreadingFactor));
-        uint8_t config3 = (uint8_t(pSpreadingFactor) >= uint8_t(SpreadingFactor::SF_11) ? LOWDATARATEOPTIMIZEMASK : 0); // DEFAULT LNA GAIN IS G1
+        uint8_t config1 = ModemConfig1Register::compose(pBandwidth, pCodingRate, implicitHeader);
+        uint8_t config2 = ModemConfig2Register::compose(pSpreadingFactor, false, payloadCrc,
+            RegisterField<SYMBTIMEOUTMSBMASK>::get(getShadowOr(REGMODEMCONFIG2, MODEMCONFIG2RESET))); // kept from setRxWindow
+        uint8_t config3 = ModemConfig3Register::compose(uint8_t(pSpreadingFactor) >= uint8_t(SpreadingFactor::SF_11),
+            RegisterField<AGCAUTOONMASK>::get(getShadowOr(REGMODEMCONFIG3, 0x00))); // kept from setRxFrontEnd
+
+        setShadow(REGMODEMCONFIG1, config1);
+        setShadow(REGMODEMCONFIG2, config2);
+        setShadow(REGMODEMCONFIG3, config3);
+    }
+
+    void setPreambleLength(uint16_t pLength)
+    {
+        // 4.1.1.6. LoRaTM Packet Structure - SX1276/77/78/79 DATASHEET
+        // Programmed length is 6 to 65535 symbols, the modem adds 4.25 symbols
+        setShadow(REGPREAMBLEMSB, pLength>>8);
+        setShadow(REGPREAMBLELSB, pLength&0xFF);
+    }
+
+    void setSyncWord(uint8_t pSyncWord)
+    {
+        // 6.4.    LoRa Mode Register Map - SX1276/77/78/79 DATASHEET
+        // Frames with another sync word are rejected by the modem, 0x34 is reserved for LoRaWAN
+        setShadow(REGSYNCWORD, pSyncWord);
+    }
+
+    void setPaRamp(PaRamp pRamp)
+    {
+        // 5.4.2. RF Power Amplifiers - SX1276/77/78/79 DATASHEET
+        // 6.4.   LoRa Mode Register Map - SX1276/77/78/79 DATASHEET
+        uint8_t paRamp = (getShadowOr(REGPARAMP, 0x09) & ~PARAMPMASK) | RegisterField<PARAMPMASK>::set(unsigned(pRamp));
+        setShadow(REGPARAMP, paRamp);
+    }
+
+    // RX front end: pGain is the manual LNA gain, ignored when pAgc lets the AGC loop pick it.
+    // pHfBoost raises the LNA current on RFI_HF, the 433 MHz band of the SX1278.
+    void setRxFrontEnd(LnaGain pGain, bool pHfBoost, bool pAgc)
+    {
+        // 5.5.    Receiver Description - SX1276/77/78/79 DATASHEET
+        // 6.4.    LoRa Mode Register Map - SX1276/77/78/79 DATASHEET
+        if (uint8_t(pGain) < uint8_t(LnaGain::G1) || uint8_t(pGain) > uint8_t(LnaGain::G6))
+        {
+            throw std::runtime_error("SX1278::setRxFrontEnd invalid LNA gain!");
+        }
+
+        uint8_t lna = LnaRegister::compose(pGain, LnaBoostLf::DEFAULT, pHfBoost ? LnaBoostHf::BOOST_ON : LnaBoostHf::DEFAULT);
+        uint8_t config3 = (getShadowOr(REGMODEMCONFIG3, 0x00) & ~AGCAUTOONMASK) | RegisterField<AGCAUTOONMASK>::set(pAgc);
+
+        setShadow(REGLNA, lna);
+        setShadow(REGMODEMCONFIG3, config3);
+    }
+
+    bool isAgc() const
+    {
+        return RegisterField<AGCAUTOONMASK>::get(getShadowOr(REGMODEMCONFIG3, 0x00));
+    }
+
+    // Gain in use, read from the device: with AGC on it is the gain picked by the loop
+    LnaGain getCurrentLnaGain()
+    {
+        // 6.4.    LoRa Mode Register Map - SX1276/77/78/79 DATASHEET
+        uint8_t lna;
+        readRegisters(REGLNA, &lna, 1);
+        return LnaGain(RegisterField<LNAGAINMASK>::get(lna));
+    }
 
-        mModemConfig1 = config1;
-        mModemConfig2 = config2;
-        mModemConfig3 = config3;
+    // Warm standby: TX idles in FSTX instead of standby, the synthesizer stays locked between
+    // frames so TX starts with the PA ramp only
+    void setWarmStandby(bool pWarm)
+    {
+        mTxWarm = pWarm;
+    }
 
-        setRegister(REGMODEMCONFIG1, config1);
-        setRegister(REGMODEMCONFIG2, config2);
-        setRegister(REGMODEMCONFIG3, config3);
+    // Implicit header: frames have a fixed pLength, TX pads shorter frames with zeros.
+    // 0 leaves the header mode to configureModem and the length to the received header.
+    void setImplicitLength(uint8_t pLength)
+    {
+        // 4.1.1.6. LoRaTM Packet Structure - SX1276/77/78/79 DATASHEET
+        // Without the header, RegPayloadLength gives the length to both ends
+        if (Usage::TRX == mUsage && pLength > HALF_DUPLEX_MTU)
+        {
+            throw std::runtime_error("SX1278::setImplicitLength length exceeds the half-duplex FIFO split!");
+        }
+        if (pLength)
+        {
+            setShadow(REGMODEMCONFIG1, getShadowOr(REGMODEMCONFIG1, MODEMCONFIG1RESET) | IMPLICITHEADERMODEONMASK);
+            setShadow(REGPAYLOADLENGTH, pLength);
+        }
+        mImplicitLength = pLength;
     }
 
     void setOutputPower(int8_t pPower)
@@ -129,13 +453,9 @@ public:
             power = pPower-2;
         }
 
-        uint8_t paConfig = uint8_t(
-                    setMasked(PASELECTMASK, isPaBoost) |
-                    setMasked(MAXPOWERMASK, 7) |
-                    setMasked(OUTPUTPOWERMASK, power));
+        uint8_t paConfig = PaConfigRegister::compose(isPaBoost, 7, power);
 
-        mPaConfig = paConfig;
-        setRegister(REGPACONFIG, paConfig);
+        setShadow(REGPACONFIG, paConfig);
     }
 
     void standby()
@@ -143,15 +463,74 @@ public:
         setMode(Mode::STDBY);
     }
 
+    // RX single windows: every pPeriod the receiver listens for pSymbols symbols for a preamble,
+    // a reception started in the window extends it up to RxDone
+    void setRxWindow(uint16_t pSymbols, std::chrono::microseconds pPeriod)
+    {
+        // 4.1.6.  LoRaTM Modem State Machine Sequences - SX1276/77/78/79 DATASHEET
+        // 6.4.    LoRa Mode Register Map - SX1276/77/78/79 DATASHEET
+        // SymbTimeout is 10 bits wide
+        if (!pSymbols || pSymbols > 1023)
+        {
+            throw std::runtime_error("SX1278::setRxWindow symbol timeout out of range!");
+        }
+        uint8_t config2 = (getShadowOr(REGMODEMCONFIG2, MODEMCONFIG2RESET) & ~SYMBTIMEOUTMSBMASK)
+                        | RegisterField<SYMBTIMEOUTMSBMASK>::set(pSymbols>>8);
+        setShadow(REGMODEMCONFIG2, config2);
+        setShadow(REGSYMBTIMEOUTLSB, pSymbols&0xFF);
+        mRxWindowPeriod = pPeriod;
+    }
+
     void start()
     {
-        if (Usage::RXC == mUsage)
+        if (Usage::TRX == mUsage)
+        {
+            mTrxTx = false;
+            setShadow(REGDIOMAPPING1, getDioMapping(DIO0RXDONEMASK));
+        }
+        commit();
+        if (Usage::RXC == mUsage || Usage::TRX == mUsage)
         {
             setRegister(REGFIFOADDRPTR, 0);
             setMode(Mode::RXCONTINUOUS);
             return;
         }
+        if (Usage::TX == mUsage && mTxWarm)
+        {
+            // 4.1.6.  LoRaTM Modem State Machine Sequences - SX1276/77/78/79 DATASHEET
+            setMode(Mode::FSTX);
+            return;
+        }
         standby();
+        if (Usage::RXS == mUsage)
+        {
+            mRxWindowNext = std::chrono::steady_clock::now();
+            openRxWindow();
+        }
+    }
+
+    std::chrono::steady_clock::time_point getNextRxWindow() const
+    {
+        return mRxWindowNext;
+    }
+
+    std::chrono::microseconds getRxWindowDuration()
+    {
+        uint16_t symbols = (RegisterField<SYMBTIMEOUTMSBMASK>::get(getShadowOr(REGMODEMCONFIG2, MODEMCONFIG2RESET))<<8)
+                         | getShadowOr(REGSYMBTIMEOUTLSB, 0x64);
+        return symbols*getSymbolTime();
+    }
+
+    std::chrono::microseconds getSymbolTime()
+    {
+        return std::chrono::microseconds(uint64_t(getSymbolTimeUs(
+            Bw(RegisterField<BWMASK>::get(getShadowOr(REGMODEMCONFIG1, MODEMCONFIG1RESET))),
+            SpreadingFactor(RegisterField<SPREADINGFACTORMASK>::get(getShadowOr(REGMODEMCONFIG2, MODEMCONFIG2RESET))))));
+    }
+
+    size_t getRxTimeoutCount() const
+    {
+        return mRxTimeoutCount;
     }
 
     int getLastSnr()
@@ -166,233 +545,1267 @@ public:
         return -164+getRegister(REGPKTRSSIVALUE);
     }
 
+    std::chrono::microseconds getTimeOnAir(uint8_t pPayloadLength)
+    {
+        // 4.1.1.7. Time on air - SX1276/77/78/79 DATASHEET
+        // Uses the configured (shadow) modem settings, unset registers are at reset value
+        uint8_t config1 = getShadowOr(REGMODEMCONFIG1, MODEMCONFIG1RESET);
+        uint8_t config2 = getShadowOr(REGMODEMCONFIG2, MODEMCONFIG2RESET);
+        uint8_t config3 = getShadowOr(REGMODEMCONFIG3, 0x00);
+        uint16_t preamble = (getShadowOr(REGPREAMBLEMSB, 0x00)<<8) | getShadowOr(REGPREAMBLELSB, 0x08);
+
+        return std::chrono::microseconds(getTimeOnAirUs(
+            Bw(RegisterField<BWMASK>::get(config1)),
+            SpreadingFactor(RegisterField<SPREADINGFACTORMASK>::get(config2)),
+            CodingRate(RegisterField<CODINGRATEMASK>::get(config1)),
+            preamble,
+            RegisterField<IMPLICITHEADERMODEONMASK>::get(config1),
+            RegisterField<RXPAYLOADCRCONMASK>::get(config2),
+            RegisterField<LOWDATARATEOPTIMIZEMASK>::get(config3),
+            pPayloadLength));
+    }
+
     int getCurrentRssi()
     {
         // 5.5.5.  RSSI and SNR in LoRa Mode - SX1276/77/78/79 DATASHEET
         return -164+getRegister(REGRSSIVALUE);
     }
 
-    bool validate()
+    ValidationResult validate()
     {
-        if (0x12 != getRegister(REGVERSION))
+        // Read back the whole configured window in a single burst, mismatched
+        // registers are marked dirty so the next commit() rewrites them.
+        uint8_t first = REGVERSION;
+        uint8_t last = REGVERSION;
+        for (uint8_t i=0; i<REGISTER_COUNT; i++)
+        {
+            if (mConfigured[i])
+            {
+                first = std::min(first, i);
+                last = std::max(last, i);
+            }
+        }
+
+        uint8_t image[REGISTER_COUNT];
+        readRegisters(first, image, last-first+1);
+
+        if (0x12 != image[REGVERSION-first])
         {
             throw std::runtime_error("Invalid chip version!");
         }
 
-        return mFrLsb == getRegister(REGFRLSB) &&
-        mFrMid == getRegister(REGFRMID) &&
-        mFrMsb == getRegister(REGFRMSB) &&
-        mModemConfig1 == getRegister(REGMODEMCONFIG1) &&
-        mModemConfig2 == getRegister(REGMODEMCONFIG2) &&
-        mModemConfig3 == getRegister(REGMODEMCONFIG3) &&
-        mPaConfig == getRegister(REGPACONFIG);
+        ValidationResult rv;
+        for (uint8_t i=first; i<=last; i++)
+        {
+            if (mConfigured[i] && ((mShadow[i] ^ image[i-first]) & getValidatedBits(i)))
+            {
+                rv.mismatches.push_back({i, mShadow[i], image[i-first]});
+                mDirty[i] = true;
+            }
+        }
+        return rv;
     }
 
-    int tx(const uint8_t *pData, uint8_t pSize)
+    void commit()
     {
-        Logless(mLogger, "DBG SX1278::tx DBG ---------- tx start --------------");
-        if (Usage::TX != mUsage || pSize>=256)
+        // Flush dirty shadow registers, clean registers with a known value in
+        // between dirty ones are rewritten so that a range takes one burst.
+        // 4.1.4.  Frequency Settings - SX1276/77/78/79 DATASHEET
+        // A new FRF applies on the RegFrLsb write, it is rewritten even if unchanged
+        if (mDirty[REGFRMSB] || mDirty[REGFRMID])
         {
-            return -1;
+            mDirty[REGFRLSB] = true;
         }
 
-        setRegister(REGDIOMAPPING1, DIO0TXDONEMASK);
+        uint8_t reg = 0;
+        while (reg < REGISTER_COUNT)
+        {
+            if (!mDirty[reg])
+            {
+                reg++;
+                continue;
+            }
 
-        // 4.1.6.  LoRaTM Modem State Machine Sequences - SX1276/77/78/79 DATASHEET
-        // TODO: ANNOTATE SPECS
-        setRegister(REGPAYLOADLENGTH, pSize);
-        setRegister(REGFIFOADDRPTR, 0);
+            uint8_t start = reg;
+            uint8_t end = reg+1;
+            for (uint8_t i=end; i<REGISTER_COUNT; i++)
+            {
+                if (mDirty[i])
+                {
+                    end = i+1;
+                }
+                else if (!mValid[i] || isVolatile(i))
+                {
+                    break;
+                }
+            }
+
+            writeRegisters(start, mShadow+start, end-start);
+            for (uint8_t i=start; i<end; i++)
+            {
+                mDirty[i] = false;
+            }
+            reg = end;
+        }
+    }
 
+    void writeRegisters(uint8_t pStartReg, const uint8_t* pData, size_t pSize)
+    {
+        // 4.3. SPI Interface - SX1276/77/78/79 DATASHEET
+        // Burst access, address is automatically incremented after each byte
         uint8_t wro[257];
         uint8_t wri[257];
-
-        wro[0] = 0x80|REGFIFO;
+        if (!pSize || pSize>=sizeof(wro))
+        {
+            throw std::runtime_error("SX1278::writeRegisters invalid burst size!");
+        }
+        wro[0] = 0x80|pStartReg;
         std::memcpy(wro+1, pData, pSize);
         mSpi.xfer(wro, wri, 1+pSize);
+    }
 
-        // using namespace std::chrono_literals;
-        std::unique_lock<std::mutex> lock(mTxDoneMutex);
-        mTxDone = false;
-        setMode(Mode::TX);
-        // TODO: Configurable TX TIMEOUT
-        mRxTxDoneCv.wait(lock, [this](){
-            Logless(mLogger, "DBG SX1278::tx mRxTxDoneCv.wait pred done:_ teardown:_",(unsigned)mTxDone,(unsigned)mTeardown);
-            return mTxDone||mTeardown;
-        });
+    void readRegisters(uint8_t pStartReg, uint8_t* pData, size_t pSize)
+    {
+        // 4.3. SPI Interface - SX1276/77/78/79 DATASHEET
+        // Burst access, address is automatically incremented after each byte
+        uint8_t wro[257];
+        uint8_t wri[257];
+        if (!pSize || pSize>=sizeof(wro))
+        {
+            throw std::runtime_error("SX1278::readRegisters invalid burst size!");
+        }
+        wro[0] = 0x7F&pStartReg;
+        std::memset(wro+1, 0, pSize);
+        mSpi.xfer(wro, wri, 1+pSize);
+        std::memcpy(pData, wri+1, pSize);
+    }
 
-        if (!mTxDone)
+    int tx(const uint8_t *pData, size_t pSize)
+    {
+        if (!submit(pData, pSize))
         {
-            Logless(mLogger, "ERR SX1278::tx DBG ---------- tx timeout --------------");
-            Logger::getInstance().flush();
             return -1;
         }
-
-        Logless(mLogger, "DBG SX1278::tx ---------- tx done --------------");
         return pSize;
     }
 
-    bfc::Buffer rx()
+    TxHandle submit(const uint8_t *pData, size_t pSize, TxCallback pCallback = {})
     {
-        std::unique_lock<std::mutex> lock(bufferQueueMutex);
+        // Frames are queued and chained by the TX done handler, only blocks when the queue is full.
+        // pCallback is called from the interrupt context once the frame is sent, timed out or aborted.
+        Logless(mLogger, "DBG SX1278::submit DBG ---------- tx queue --------------");
+        if ((Usage::TX != mUsage && Usage::TRX != mUsage) ||
+            pSize>MAX_PAYLOAD_LENGTH ||
+            (mImplicitLength && pSize>mImplicitLength) ||
+            (Usage::TRX == mUsage && pSize>HALF_DUPLEX_MTU))
+        {
+            return 0;
+        }
 
-        if (!bufferQueue.size())
+        TxFrame frame = mTxPool.acquire();
+        while (!frame)
         {
-            // TODO: Configurable RX TIMEOUT
             using namespace std::chrono_literals;
-            mRxTxDoneCv.wait_for(lock, 10s, [this]{return bufferQueue.size()||mTeardown;});
+            mTxSpace.wait(100ms);
+            if (mTeardown)
+            {
+                return 0;
+            }
+            frame = mTxPool.acquire();
         }
 
-        if (!bufferQueue.size())
+        TxHandle handle = mTxNextHandle++;
+        if (!handle)
         {
-            Logless(mLogger, "SX1278::rx ERR rx timeout");
-            Logger::getInstance().flush();
-            return {};
+            handle = mTxNextHandle++;
         }
 
-        bfc::Buffer rv = std::move(bufferQueue.front());
-        bufferQueue.pop_front();
-        return rv;
+        frame->raw[0] = 0x80|REGFIFO;
+        std::memcpy(frame->data(), pData, pSize);
+        frame->size = pSize;
+        if (mImplicitLength)
+        {
+            std::memset(frame->data()+pSize, 0, mImplicitLength-pSize);
+            frame->size = mImplicitLength;
+        }
+        frame->handle = handle;
+        frame->callback = std::move(pCallback);
+        frame->enqueued = std::chrono::steady_clock::now();
+
+        mTxQueue.push(frame.detach(), [this](size_t pDropped){mTxPool.adopt(pDropped);});
+        if (!mTxBusy.exchange(true))
+        {
+            kickTx();
+        }
+        return handle;
     }
 
-private:
+    // Listen before talk: CAD runs before each TX, a busy channel is retried after a random
+    // backoff within a window doubling from pWindow up to pMaxWindow. A frame is completed as
+    // CHANNEL_BUSY after pMaxAttempts busy CADs. A zero pWindow disables it.
+    void setListenBeforeTalk(std::chrono::microseconds pWindow, std::chrono::microseconds pMaxWindow, unsigned pMaxAttempts)
+    {
+        mLbtWindow = pWindow;
+        mLbtMaxWindow = std::max(pWindow, pMaxWindow);
+        mLbtMaxAttempts = pMaxAttempts;
+    }
 
-    void setRegister(uint8_t pReg, uint8_t val)
+    // Submit to TX done of sent frames
+    std::chrono::microseconds getAverageTxLatency() const
     {
-        uint8_t wro[2] = {uint8_t(0x80|pReg), val};
-        uint8_t wri[2];
-        mSpi.xfer(wro, wri, 2);
+        size_t count = mTxSentCount;
+        return std::chrono::microseconds(count ? mTxLatencyTotal/count : 0);
     }
 
-    uint8_t getRegister(uint8_t pReg)
+    size_t getCadCount() const
     {
-        uint8_t wro[2] = {pReg, 0};
-        uint8_t wri[2];
-        mSpi.xfer(wro, wri, 2);
-        return wri[1];
+        return mCadCount;
     }
 
-    uint8_t getMode()
+    size_t getCadBusyCount() const
     {
-        return getUnmasked(MODEMASK, getRegister(REGOPMODE));
+        return mCadBusyCount;
     }
 
-    void setMode(Mode mode)
+    // Throws on parameters the setters below would reject, before any of them is applied
+    void checkModemParams(const ModemParams& pParams) const
     {
-        setRegister(REGOPMODE, LONGRANGEMODEMASK | LOWFREQUENCYMODEONMASK | setMasked(MODEMASK, uint8_t(mode)));
+        // 5.4.2. RF Power Amplifiers - SX1276/77/78/79 DATASHEET
+        // 4.1.1.6. LoRaTM Packet Structure - SX1276/77/78/79 DATASHEET
+        if (uint8_t(pParams.bandwidth) > uint8_t(Bw::BW_500_KHZ) ||
+            uint8_t(pParams.codingRate) < uint8_t(CodingRate::CR_4V5) || uint8_t(pParams.codingRate) > uint8_t(CodingRate::CR_4V8) ||
+            uint8_t(pParams.spreadingFactor) < uint8_t(SpreadingFactor::SF_6) || uint8_t(pParams.spreadingFactor) > uint8_t(SpreadingFactor::SF_12) ||
+            uint8_t(pParams.rxGain) < uint8_t(LnaGain::G1) || uint8_t(pParams.rxGain) > uint8_t(LnaGain::G6) ||
+            pParams.txPower < 0 || pParams.txPower > 17 ||
+            pParams.preambleLength < 6)
+        {
+            throw std::runtime_error("SX1278::checkModemParams invalid modem parameters!");
+        }
+        if (Usage::TRX == mUsage && pParams.implicitLength > HALF_DUPLEX_MTU)
+        {
+            throw std::runtime_error("SX1278::checkModemParams length exceeds the half-duplex FIFO split!");
+        }
     }
 
-    void init()
+    void configure(const ModemParams& pParams)
     {
-        mUsage = Usage::UNSPEC;
-        setRegister(REGOPMODE, 0); // Sleep Mode
-        setRegister(REGOPMODE, LONGRANGEMODEMASK | LOWFREQUENCYMODEONMASK); // Set LoRa
-        standby();
-        // 4.1.2.3.  LoRa Mode FIFO Data Buffer - SX1276/77/78/79 DATASHEET
-        // 4.1.6.    LoRa Modem State Machine Sequences - SX1276/77/78/79 DATASHEET
-        setRegister(REGFIFOTXBASEADD, 0);
-        setRegister(REGFIFORXBASEADD, 0);
-        setRegister(REGFIFORXCURRENTADDR, 0);
+        checkModemParams(pParams);
+        if (!isHopping())
+        {
+            setCarrier(pParams.carrier);
+        }
+        configureModem(pParams.bandwidth, pParams.codingRate, pParams.implicitLength>0, pParams.spreadingFactor, pParams.payloadCrc);
+        setImplicitLength(pParams.implicitLength);
+        setPreambleLength(pParams.preambleLength);
+        setSyncWord(pParams.syncWord);
+        setOutputPower(pParams.txPower);
+        setRxFrontEnd(pParams.rxGain, pParams.lnaBoost, pParams.agc);
     }
 
-    void onDio1()
+    // Switches the running modem to pParams without reset: TX is paused after the in-flight frame
+    // (aborted if pAbortInFlight), only the changed registers are written in standby, then RX or
+    // the TX queue resumes. Queued frames are kept. Returns the switchover time.
+    // Invalid pParams throw before the running modem is touched.
+    std::chrono::microseconds reconfigure(const ModemParams& pParams, bool pAbortInFlight)
     {
-        if (Usage::RXC == mUsage)
+        checkModemParams(pParams);
+        auto begin = std::chrono::steady_clock::now();
+
+        mTxPaused = true;
+        bool isChainOwner = false;
+        if (pAbortInFlight && (mTxInFlightHandle || mTxDeferred))
         {
-            Logless(mLogger, "DBG SX1278::onDio1 RX DONE \\");
-            // TODO: ANNOTATE SPECS
-            // TODO: what value in implicit header
-            uint8_t rcvSz = getRegister(REGRXNBBYTES);
-            uint8_t currRx = getRegister(REGFIFORXCURRENTADDR);
-            uint8_t rdBase = getRegister(REGFIFOADDRPTR);
-            if (uint8_t(currRx+rcvSz) == rdBase)
-            {
-                Logless(mLogger, "ERR SX1278::onDio1 FALSE RX");
-                return;
-            }
+            standby();
+            isChainOwner = completeTx(TxStatus::ABORTED, 0);
+        }
 
-            if (currRx>rdBase)
-            {
-                Logless(mLogger, "ERR SX1278::onDio1 FALSE RX");
-                rcvSz += (currRx-rdBase);
-            }
-            else if (currRx<rdBase)
-            {
-                Logless(mLogger, "WRN SX1278::onDio1 CURRENTRX > READBASE! Mising Interrupt?!");
-                rcvSz += (255-rdBase)+currRx;
-            }
+        // Otherwise the chain owner drops ownership on its next completion while paused
+        while (!isChainOwner && mTxBusy.exchange(true))
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
 
-            bfc::Buffer pvect(new std::byte[rcvSz], size_t(rcvSz));
-            ssize_t maxsize = 256-currRx;
-            uint8_t wro[257];
-            uint8_t wri[257];
-            wro[0] = REGFIFO;
+        mRxWindowTimer.cancel();
+        {
+            // RX done keeps running until standby, it shares the SPI and the shadow
+            std::lock_guard<std::mutex> lock(mFifoMutex);
+            standby();
+            disarmRx();
+            configure(pParams);
+            start();
+        }
 
-            if (rcvSz>=maxsize)
-            {
-                Logless(mLogger, "WRN SX1278::onDio1 FIFO AT: _", unsigned(rdBase));
-                mSpi.xfer(wro, wri, 1+maxsize);
-                std::memcpy(pvect.data(), wri+1, maxsize);
-                if (size_t remSize = rcvSz-maxsize)
-                {
-                    Logless(mLogger, "WRN SX1278::onDio1 FIFO AT: _", unsigned(getRegister(REGFIFOADDRPTR)));
-                    mSpi.xfer(wro, wri, 1+remSize);
-                    std::memcpy(pvect.data()+maxsize, wri+1, remSize);
+        mTxPaused = false;
+        kickTx();
+
+        auto switchover = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-begin);
+        Logless(mLogger, "INF SX1278::reconfigure switchover: _ us", int64_t(switchover.count()));
+        return switchover;
+    }
+
+    void abortTx()
+    {
+        // In-flight and queued frames are completed as ABORTED, a frame started
+        // by a concurrent TX done is left to complete normally.
+        if (Usage::TRX != mUsage || mTrxTx)
+        {
+            standby();
+        }
+        bool isChainOwner = completeTx(TxStatus::ABORTED, 0);
+
+        size_t index;
+        while (mTxQueue.pop(index))
+        {
+            TxFrame frame = mTxPool.adopt(index);
+            notifyTx(frame, TxStatus::ABORTED, 0);
+        }
+
+        // An idle chain is taken over to bring the modem back to its idle mode
+        if (isChainOwner || !mTxBusy.exchange(true))
+        {
+            kickTx();
+        }
+    }
+
+    RxFrame rx()
+    {
+        // TODO: Configurable RX TIMEOUT
+        using namespace std::chrono_literals;
+        size_t index;
+        if (!mRxQueue.pop(index, 10s))
+        {
+            if (!mTeardown)
+            {
+                Logless(mLogger, "SX1278::rx ERR rx timeout");
+                Logger::getInstance().flush();
+            }
+            return {};
+        }
+
+        return mRxPool.adopt(index);
+    }
+
+    size_t getRxDropCount() const
+    {
+        return mRxQueue.getDropCount();
+    }
+
+    size_t getRxFrameCount() const
+    {
+        return mRxFrameCount;
+    }
+
+    // Packet error rate is getRxCrcErrorCount()/(getRxCrcErrorCount()+getRxFrameCount())
+    size_t getRxCrcErrorCount() const
+    {
+        return mRxCrcErrorCount;
+    }
+
+private:
+
+    static constexpr uint8_t REGISTER_COUNT = 128;
+    static constexpr std::chrono::milliseconds TX_TIMEOUT_MARGIN{10};
+    static constexpr unsigned CAD_TIMEOUT_SYMBOLS = 4;
+    static constexpr unsigned IRQ_POLL_SPIN_COUNT = 1000;
+    static constexpr unsigned IRQ_POLL_MAX_BACKOFF_SHIFT = 6; // 64us
+    static constexpr size_t IRQ_QUEUE_SIZE = 16;
+    static constexpr std::chrono::microseconds TICK_MAX_AGE = std::chrono::seconds(1);
+    static constexpr uint32_t TICK_DRIFT_US = 1;
+
+    enum class IrqLine : uint8_t {TXRX_DONE, VALID_HEADER, RX_TIMEOUT};
+
+    static bool isVolatile(uint8_t pReg)
+    {
+        // Registers that are changed by the modem itself or have side effects on access
+        return REGFIFO == pReg ||
+            REGOPMODE == pReg ||
+            REGFIFOADDRPTR == pReg ||
+            REGFIFORXCURRENTADDR == pReg ||
+            (REGIRQFLAGS <= pReg && REGHOPCHANNEL >= pReg) ||
+            REGFIFORXBYTEADDR == pReg ||
+            (REGFEIMSB <= pReg && REGRSSIWIDEBAND >= pReg) ||
+            REGFORMERTEMP == pReg;
+    }
+
+    void setShadow(uint8_t pReg, uint8_t pVal)
+    {
+        if (!mValid[pReg] || mShadow[pReg] != pVal)
+        {
+            mDirty[pReg] = true;
+        }
+        mShadow[pReg] = pVal;
+        mValid[pReg] = true;
+        mConfigured[pReg] = true;
+    }
+
+    void readShadowed(uint8_t pStartReg, uint8_t* pData, size_t pSize)
+    {
+        bool isShadowed = true;
+        for (size_t i=0; i<pSize; i++)
+        {
+            uint8_t reg = pStartReg+i;
+            isShadowed = isShadowed && !isVolatile(reg) && mValid[reg];
+        }
+
+        if (isShadowed)
+        {
+            std::memcpy(pData, mShadow+pStartReg, pSize);
+            return;
+        }
+
+        readRegisters(pStartReg, pData, pSize);
+        for (size_t i=0; i<pSize; i++)
+        {
+            uint8_t reg = pStartReg+i;
+            if (!isVolatile(reg) && !mDirty[reg])
+            {
+                mShadow[reg] = pData[i];
+                mValid[reg] = true;
+            }
+        }
+    }
+
+    void setRegister(uint8_t pReg, uint8_t val)
+    {
+        uint8_t wro[2] = {uint8_t(0x80|pReg), val};
+        uint8_t wri[2];
+        mSpi.xfer(wro, wri, 2);
+        if (!isVolatile(pReg))
+        {
+            mShadow[pReg] = val;
+            mValid[pReg] = true;
+            mDirty[pReg] = false;
+        }
+    }
+
+    bool isRx() const
+    {
+        return Usage::RXC == mUsage || Usage::RXS == mUsage || (Usage::TRX == mUsage && !mTrxTx);
+    }
+
+    bool isHopping() const
+    {
+        return !mHopTable.empty();
+    }
+
+    std::array<uint8_t, 3> getFrf(uint64_t pCf) const
+    {
+        // 4.1.4.  Frequency Settings - SX1276/77/78/79 DATASHEET
+        pCf = (pCf*524288ul)/mFosc;
+        return {uint8_t((pCf>>16)&0xFF), uint8_t((pCf>>8)&0xFF), uint8_t(pCf&0xFF)};
+    }
+
+    uint8_t getDioMapping(uint8_t pDio0) const
+    {
+        // 4.1.6.1.  Digital IO Pin Mapping - SX1276/77/78/79 DATASHEET
+        // DIO0 follows the operation, DIO1 and DIO3 the lines in use.
+        // DIO1 is RxTimeout (DIO1RXTOUTMASK) unless hopping.
+        uint8_t mapping = pDio0;
+        if (isHopping())
+        {
+            mapping |= DIO1FHSSCHANGECHANNELMASK;
+        }
+        if (isRx() && mDio3Pin >= 0)
+        {
+            mapping |= DIO3VALIDHEADERMASK;
+        }
+        return mapping;
+    }
+
+    // Bits of pReg owned by the configuration, the rest is driven by the chip
+    uint8_t getValidatedBits(uint8_t pReg) const
+    {
+        if (REGLNA == pReg && isAgc())
+        {
+            return uint8_t(~LNAGAINMASK);
+        }
+        return 0xFF;
+    }
+
+    // Configured value, or pResetValue if it was never set
+    uint8_t getShadowOr(uint8_t pReg, uint8_t pResetValue) const
+    {
+        return mValid[pReg] ? mShadow[pReg] : pResetValue;
+    }
+
+    uint8_t getRegister(uint8_t pReg)
+    {
+        uint8_t val;
+        readShadowed(pReg, &val, 1);
+        return val;
+    }
+
+    uint8_t getMode()
+    {
+        return RegisterField<MODEMASK>::get(getRegister(REGOPMODE));
+    }
+
+    void setMode(Mode mode)
+    {
+        setRegister(REGOPMODE, OpModeRegister::compose(true, false, true, mode));
+    }
+
+    void init()
+    {
+        mUsage = Usage::UNSPEC;
+        mValid.reset();
+        mDirty.reset();
+        mConfigured.reset();
+        setRegister(REGOPMODE, 0); // Sleep Mode
+        setRegister(REGOPMODE, LONGRANGEMODEMASK | LOWFREQUENCYMODEONMASK); // Set LoRa
+        standby();
+        // 4.1.2.3.  LoRa Mode FIFO Data Buffer - SX1276/77/78/79 DATASHEET
+        // 4.1.6.    LoRa Modem State Machine Sequences - SX1276/77/78/79 DATASHEET
+        setRegister(REGFIFOTXBASEADD, 0);
+        setRegister(REGFIFORXBASEADD, 0);
+        setRegister(REGFIFORXCURRENTADDR, 0);
+    }
+
+    bool startNextTx()
+    {
+        size_t index;
+        if (!mTxQueue.pop(index))
+        {
+            return false;
+        }
+
+        mTxInFlight = mTxPool.adopt(index);
+        // Half-duplex receives until the turnaround, the frame is loaded behind RX
+        bool isTurnaround = Usage::TRX == mUsage && !mTrxTx;
+        if (mTxWarm && !isTurnaround)
+        {
+            // TX done went back to standby, the PLL locks while the FIFO is loaded
+            setMode(Mode::FSTX);
+        }
+        mTxCad = mLbtWindow.count() > 0;
+        mTxCadAttempts = 0;
+
+        // 4.1.6.  LoRaTM Modem State Machine Sequences - SX1276/77/78/79 DATASHEET
+        Logless(mLogger, "DBG SX1278::startNextTx ---------- tx start -------------- size: _", mTxInFlight->size);
+        if (!isTurnaround)
+        {
+            setShadow(REGDIOMAPPING1, getDioMapping(mTxCad ? DIO0CADDONEMASK : DIO0TXDONEMASK));
+        }
+        setShadow(REGPAYLOADLENGTH, mTxInFlight->size);
+        {
+            std::lock_guard<std::mutex> lock(mFifoMutex);
+            commit();
+            setRegister(REGFIFOADDRPTR, getShadowOr(REGFIFOTXBASEADD, 0));
+
+            // FIFO is kept through CAD and standby, the frame is loaded once
+            uint8_t wri[257];
+            mSpi.xfer(mTxInFlight->raw, wri, 1+mTxInFlight->size);
+        }
+
+        if (isTurnaround)
+        {
+            turnToTx(mTxInFlight->handle);
+            return true;
+        }
+
+        resetHop();
+
+        if (mTxCad)
+        {
+            startCad();
+        }
+        else
+        {
+            startTx();
+        }
+        return true;
+    }
+
+    void startTx()
+    {
+        setShadow(REGDIOMAPPING1, getDioMapping(DIO0TXDONEMASK));
+        commit();
+
+        // TX done is expected within the time on air, twice of it is allowed before the frame is timed out
+        TxHandle handle = mTxInFlight->handle;
+        mTxInFlight->txStart = std::chrono::steady_clock::now();
+        mTxWatchdog.schedule(mTxInFlight->txStart + 2*getTimeOnAir(mTxInFlight->size) + TX_TIMEOUT_MARGIN,
+            [this, handle](){onTxTimeout(handle);});
+        setMode(Mode::TX);
+
+        // Only a started frame can be claimed by TX done
+        mTxInFlightHandle.store(handle);
+    }
+
+    void startCad()
+    {
+        // 4.1.6.  LoRaTM Modem State Machine Sequences - SX1276/77/78/79 DATASHEET
+        // CAD takes about two symbols, CadDone is timed out like a lost TX done
+        setShadow(REGDIOMAPPING1, getDioMapping(DIO0CADDONEMASK));
+        commit();
+
+        TxHandle handle = mTxInFlight->handle;
+        mTxWatchdog.schedule(std::chrono::steady_clock::now() + CAD_TIMEOUT_SYMBOLS*getSymbolTime() + TX_TIMEOUT_MARGIN,
+            [this, handle](){onTxTimeout(handle);});
+        setMode(Mode::CAD);
+        mTxInFlightHandle.store(handle);
+    }
+
+    void onCadDone(uint32_t pTick)
+    {
+        uint8_t flags = getRegister(REGIRQFLAGS);
+        setRegister(REGIRQFLAGS, CADDONEMASK|CADDETECTEDMASK);
+
+        TxHandle handle = mTxInFlightHandle;
+        if (!handle || !(flags & CADDONEMASK))
+        {
+            Logless(mLogger, "ERR SX1278::onCadDone FALSE CAD DONE irq:_", unsigned(flags));
+            return;
+        }
+
+        mCadCount++;
+        if (!(flags & CADDETECTEDMASK))
+        {
+            mTxCad = false;
+            startTx();
+            return;
+        }
+
+        mCadBusyCount++;
+        if (++mTxCadAttempts >= mLbtMaxAttempts)
+        {
+            Logless(mLogger, "WRN SX1278::onCadDone channel busy, giving up handle: _", handle);
+            if (completeTx(TxStatus::CHANNEL_BUSY, pTick, handle))
+            {
+                kickTx();
+            }
+            return;
+        }
+
+        // Randomized exponential backoff, the modem is back in standby after CAD
+        auto window = std::min(mLbtMaxWindow, mLbtWindow*(1u<<std::min(mTxCadAttempts-1, 16u)));
+        std::uniform_int_distribution<int64_t> backoff(0, window.count());
+        auto delay = std::chrono::microseconds(backoff(mLbtRandom));
+        Logless(mLogger, "DBG SX1278::onCadDone channel busy, backoff: _ us", int64_t(delay.count()));
+        mTxWatchdog.schedule(std::chrono::steady_clock::now() + delay, [this, handle](){
+                if (handle == mTxInFlightHandle)
+                {
+                    startCad();
                 }
+            });
+    }
+
+    void turnToTx(TxHandle pHandle)
+    {
+        // 4.1.6.  LoRaTM Modem State Machine Sequences - SX1276/77/78/79 DATASHEET
+        // An ongoing reception is completed first, its RX done starts the deferred frame.
+        // A reception that just ended has RxDone raised before its edge is served.
+        std::lock_guard<std::mutex> lock(mFifoMutex);
+        uint8_t status[REGMODEMSTAT-REGIRQFLAGS+1];
+        readRegisters(REGIRQFLAGS, status, sizeof(status));
+        if ((status[0] & RXDONEMASK) || (status[REGMODEMSTAT-REGIRQFLAGS] & RXONGOINGMASK))
+        {
+            mTxDeferred = pHandle;
+            // A reception lost on a header error never raises RX done, retry after the longest frame
+            mTxWatchdog.schedule(std::chrono::steady_clock::now() + getTimeOnAir(HALF_DUPLEX_MTU),
+                [this, pHandle](){
+                    TxHandle handle = pHandle;
+                    if (mTxDeferred.compare_exchange_strong(handle, 0))
+                    {
+                        turnToTx(pHandle);
+                    }
+                });
+            Logless(mLogger, "DBG SX1278::turnToTx rx ongoing, deferred handle: _", pHandle);
+            return;
+        }
+        disarmRx();
+        startTurnaroundTx();
+    }
+
+    void startTurnaroundTx()
+    {
+        // Only the DIO mapping and the mode are written, the frame is already in the FIFO
+        mTrxTx = true;
+        resetHop();
+        if (mTxCad)
+        {
+            startCad();
+        }
+        else
+        {
+            startTx();
+        }
+    }
+
+    void turnToRx()
+    {
+        // Half-duplex idles in RX continuous
+        if (!mTrxTx.exchange(false))
+        {
+            return;
+        }
+        setShadow(REGDIOMAPPING1, getDioMapping(DIO0RXDONEMASK));
+        commit();
+        setMode(Mode::RXCONTINUOUS);
+    }
+
+    void onTxTimeout(TxHandle pHandle)
+    {
+        if (!completeTx(TxStatus::TIMEOUT, 0, pHandle))
+        {
+            return;
+        }
+
+        Logless(mLogger, "ERR SX1278::onTxTimeout ---------- tx timeout -------------- handle: _", pHandle);
+        standby();
+        kickTx();
+    }
+
+    void notifyTx(TxFrame& pFrame, TxStatus pStatus, uint32_t pTick)
+    {
+        TxResult result{pFrame->handle, pStatus, pTick, {}, {}, getTickTime(pTick)};
+        if (TxStatus::SENT == pStatus)
+        {
+            // Measured to the TX done edge, the interrupt handling delay is left out
+            result.airtime = std::chrono::duration_cast<std::chrono::microseconds>(result.timestamp - pFrame->txStart);
+            result.latency = std::chrono::duration_cast<std::chrono::microseconds>(result.timestamp - pFrame->enqueued);
+            mTxLatencyTotal += result.latency.count();
+            mTxSentCount++;
+        }
+
+        Logless(mLogger, "DBG SX1278::notifyTx handle: _ status: _ airtime: _us latency: _us", result.handle, enumToString(pStatus), result.airtime.count(), result.latency.count());
+        TxCallback callback = std::move(pFrame->callback);
+        pFrame.release();
+        mTxSpace.notify();
+        if (callback)
+        {
+            callback(result);
+        }
+    }
+
+    bool completeTx(TxStatus pStatus, uint32_t pTick, TxHandle pHandle = 0)
+    {
+        // The in-flight frame is claimed once, whoever claims it owns the TX chain
+        if (pHandle)
+        {
+            if (!mTxInFlightHandle.compare_exchange_strong(pHandle, 0))
+            {
+                return false;
+            }
+        }
+        else if (!mTxInFlightHandle.exchange(0) && !mTxDeferred.exchange(0))
+        {
+            return false;
+        }
+        notifyTx(mTxInFlight, pStatus, pTick);
+        return true;
+    }
+
+    void kickTx()
+    {
+        // Only called by the owner of mTxBusy, ownership is dropped when the queue is empty or TX is paused
+        while (mTxPaused || !startNextTx())
+        {
+            if (Usage::TRX == mUsage && !mTxPaused)
+            {
+                turnToRx();
             }
-            else
+            else if (mTxWarm && !mTxPaused)
             {
-                mSpi.xfer(wro, wri, 1+rcvSz);
-                std::memcpy(pvect.data(), wri+1, rcvSz);
-                Logless(mLogger, "DBG SX1278::onDio1 FIFO AT: _", unsigned(rdBase));
+                setMode(Mode::FSTX);
             }
+            mTxBusy.store(false);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (mTxPaused || !mTxQueue.size() || mTxBusy.exchange(true))
+            {
+                return;
+            }
+        }
+    }
+
+    static RxMetadata getRxMetadata(const uint8_t* pStatus)
+    {
+        // 6.4.    LoRa Mode Register Map - SX1276/77/78/79 DATASHEET
+        auto statusOf = [pStatus](uint8_t pReg) {return pStatus[pReg-REGFIFOADDRPTR];};
+        RxMetadata rv{};
+        rv.irqFlags = statusOf(REGIRQFLAGS);
+        rv.size = statusOf(REGRXNBBYTES);
+        rv.headerCount = (statusOf(REGRXHEADERCNTVALUEMSB)<<8) | statusOf(REGRXHEADERCNTVALUELSB);
+        rv.packetCount = (statusOf(REGRXPACKETCNTVALUEMSB)<<8) | statusOf(REGRXPACKETCNTVALUELSB);
+        rv.modemStat = statusOf(REGMODEMSTAT);
+        rv.snr = int8_t(statusOf(REGPKTSNRVALUE));
+        rv.rssi = statusOf(REGPKTRSSIVALUE);
+        return rv;
+    }
+
+    // Steady clock in microseconds, wrapping at 32 bits like the gpio tick
+    static uint32_t getTick(std::chrono::steady_clock::time_point pTime = std::chrono::steady_clock::now())
+    {
+        return uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(pTime.time_since_epoch()).count());
+    }
+
+    std::chrono::steady_clock::time_point getTickTime(uint32_t pTick)
+    {
+        // The gpio tick has its own epoch (pigpio counts from SoC power-up), the offset to the
+        // steady clock is the smallest now-tick seen, i.e. the edge served with the least delay.
+        // It creeps up by TICK_DRIFT_US per edge to follow a drift between the clocks, and
+        // restarts from an edge older than TICK_MAX_AGE (first edge, tick source restarted),
+        // which is stamped with the handling time. Arithmetic is modulo the 32 bit wrap.
+        auto now = std::chrono::steady_clock::now();
+        uint32_t sample = getTick(now)-pTick;
+        uint32_t offset = mTickOffset.load(std::memory_order_relaxed);
+        int32_t age = int32_t(sample-offset);
+        if (age <= 0 || std::chrono::microseconds(age) > TICK_MAX_AGE)
+        {
+            mTickOffset.store(sample, std::memory_order_relaxed);
+            return now;
+        }
+        mTickOffset.store(uint32_t(age) < TICK_DRIFT_US ? sample : offset+TICK_DRIFT_US, std::memory_order_relaxed);
+        return now-std::chrono::microseconds(age);
+    }
+
+    void setupIrqThread(int pCpu, int pPriority)
+    {
+        if (pCpu >= 0 && !setCurrentThreadAffinity(pCpu))
+        {
+            Logless(mLogger, "ERR SX1278::setupIrqThread failed to pin irq thread to cpu: _", pCpu);
+        }
+        if (pPriority > 0 && !setCurrentThreadPriority(pPriority))
+        {
+            Logless(mLogger, "ERR SX1278::setupIrqThread failed to set SCHED_FIFO priority: _", pPriority);
+        }
+    }
 
+    void postIrq(IrqLine pLine, uint32_t pTick)
+    {
+        if (IrqMode::THREAD != mIrqMode)
+        {
+            onIrq(pLine, pTick);
+            return;
+        }
+
+        // GPIO backend context: no SPI, no allocation, no logging. The backend dispatches
+        // edges from a single thread which makes it the only producer of the queue.
+        mIrqQueue.push((uint64_t(pLine)<<32)|pTick, [](uint64_t){});
+    }
+
+    void onIrq(IrqLine pLine, uint32_t pTick)
+    {
+        switch (pLine)
+        {
+            case IrqLine::TXRX_DONE:
+                onDio1(pTick);
+                break;
+            case IrqLine::VALID_HEADER:
+                onValidHeader(pTick);
+                break;
+            case IrqLine::RX_TIMEOUT:
+                // DIO1 is FhssChangeChannel while hopping, RxTimeout otherwise
+                if (isHopping())
+                {
+                    onFhssChangeChannel(pTick);
+                }
+                else
+                {
+                    onRxTimeout(pTick);
+                }
+                break;
+        }
+    }
+
+    void runIrqWorker(int pCpu, int pPriority)
+    {
+        setupIrqThread(pCpu, pPriority);
+
+        // Edges are served in arrival order with their original tick
+        while (!mTeardown)
+        {
+            uint64_t event;
+            if (mIrqQueue.pop(event, std::chrono::milliseconds(100)))
+            {
+                onIrq(IrqLine(event>>32), uint32_t(event));
+            }
+        }
+    }
+
+    void runIrqPoller(int pCpu, int pPriority)
+    {
+        setupIrqThread(pCpu, pPriority);
+
+        // Spin right after activity, then back off exponentially to bound the idle SPI traffic
+        unsigned idle = 0;
+        while (!mTeardown)
+        {
+            // Only the flag that DIO0 would be mapped to is dispatched, TX done only for a started frame
+            uint8_t expected = isRx() ? RXDONEMASK : (!mTxInFlightHandle ? 0 : mTxCad ? CADDONEMASK : TXDONEMASK);
+            uint8_t hop = isHopping() ? FHSSCHANGECHANNELMASK : 0;
+            uint8_t flags = (expected|hop) ? getRegister(REGIRQFLAGS) : 0;
+            if (flags & hop)
             {
-                std::unique_lock<std::mutex> lock(bufferQueueMutex);
-                bufferQueue.push_back(std::move(pvect));
+                onFhssChangeChannel(getTick());
+                idle = 0;
+            }
+            if (flags & expected)
+            {
+                onDio1(getTick());
+                idle = 0;
+                continue;
+            }
+
+            if (++idle < IRQ_POLL_SPIN_COUNT)
+            {
+                continue;
             }
 
-            mRxTxDoneCv.notify_one();
-            setRegister(REGIRQFLAGS, RXDONEMASK);
-            Logless(mLogger, "DBG SX1278::onDio1 RX DONE /");
+            unsigned shift = std::min(idle-IRQ_POLL_SPIN_COUNT, IRQ_POLL_MAX_BACKOFF_SHIFT);
+            std::this_thread::sleep_for(std::chrono::microseconds(1u<<shift));
+        }
+    }
+
+    void openRxWindow()
+    {
+        if (mRxWindowPeriod.count() > 0)
+        {
+            auto now = std::chrono::steady_clock::now();
+            auto next = mRxWindowNext.load();
+            while (next <= now)
+            {
+                next += mRxWindowPeriod;
+            }
+            mRxWindowNext = next;
+            mRxWindowTimer.schedule(next, [this](){openRxWindow();});
+        }
+
+        // 4.1.6.  LoRaTM Modem State Machine Sequences - SX1276/77/78/79 DATASHEET
+        // RX single goes back to standby on RxDone or RxTimeout, still in RX means a reception is ongoing
+        if (Mode::RXSINGLE == Mode(getMode()))
+        {
+            Logless(mLogger, "DBG SX1278::openRxWindow still receiving, window skipped");
+            return;
+        }
+
+        // Without the RxTimeout line on DIO1 the previous window's timeout is collected here
+        if (mRxTimeoutPin < 0 || isHopping())
+        {
+            uint8_t flags = getRegister(REGIRQFLAGS);
+            if (flags & RXTIMEOUTMASK)
+            {
+                setRegister(REGIRQFLAGS, RXTIMEOUTMASK);
+                mRxTimeoutCount++;
+            }
+        }
+
+        setRegister(REGFIFOADDRPTR, 0);
+        setMode(Mode::RXSINGLE);
+    }
+
+    void onFhssChangeChannel(uint32_t)
+    {
+        // 4.1.1.8. Frequency Hopping in LoRa Mode - SX1276/77/78/79 DATASHEET
+        // Next channel is programmed in one burst during the current hop period
+        size_t index = mHopIndex.load();
+        size_t next;
+        do
+        {
+            next = (index+1)%mHopTable.size();
+        }
+        while (!mHopIndex.compare_exchange_weak(index, next));
+        writeRegisters(REGFRMSB, mHopTable[next].data(), 3);
+
+        // A resetHop that ran before the write above had its channel overwritten
+        index = mHopIndex.load();
+        if (index != next)
+        {
+            writeRegisters(REGFRMSB, mHopTable[index].data(), 3);
+        }
+        setRegister(REGIRQFLAGS, FHSSCHANGECHANNELMASK);
+    }
+
+    void resetHop()
+    {
+        // Both ends start each packet on the first channel of the table
+        if (!isHopping() || !mHopIndex.exchange(0))
+        {
+            return;
+        }
+        writeRegisters(REGFRMSB, mHopTable[0].data(), 3);
+    }
+
+    void onRxTimeout(uint32_t)
+    {
+        setRegister(REGIRQFLAGS, RXTIMEOUTMASK);
+        mRxTimeoutCount++;
+        Logless(mLogger, "DBG SX1278::onRxTimeout window closed count: _", mRxTimeoutCount.load());
+    }
+
+    void onValidHeader(uint32_t pTick)
+    {
+        if (!isRx())
+        {
+            return;
+        }
+
+        // 4.1.6.  LoRaTM Modem State Machine Sequences - SX1276/77/78/79 DATASHEET
+        // Header is decoded ahead of the payload, reserve the slot and record the arrival now
+        // so RxDone only has to move the payload. The flag is cleared with RxDone's.
+        // Serialized with RxDone, which may run on another thread (POLL, THREAD): a header seen
+        // before the previous RxDone is served leaves the armed one to its own frame.
+        std::lock_guard<std::mutex> lock(mFifoMutex);
+        if (mRxArmed.load(std::memory_order_acquire))
+        {
+            Logless(mLogger, "WRN SX1278::onValidHeader RX ALREADY ARMED!");
+            return;
+        }
+
+        uint8_t header[REGHOPCHANNEL-REGRXNBBYTES+1];
+        readRegisters(REGRXNBBYTES, header, sizeof(header));
+        auto headerOf = [&header](uint8_t pReg) {return header[pReg-REGRXNBBYTES];};
+
+        mRxArmedFrame = mRxPool.acquire();
+        if (!mRxArmedFrame)
+        {
+            Logless(mLogger, "WRN SX1278::onValidHeader RX POOL EXHAUSTED!");
+            return;
+        }
+
+        mRxArmedHeader.tick = pTick;
+        mRxArmedHeader.size = headerOf(REGRXNBBYTES);
+        mRxArmedHeader.codingRate = CodingRate(RegisterField<RXCODINGRATEMASK>::get(headerOf(REGMODEMSTAT)));
+        mRxArmedHeader.crcOn = RegisterField<CRCONPAYLOADMASK>::get(headerOf(REGHOPCHANNEL));
+        mRxArmed.store(true, std::memory_order_release);
+        Logless(mLogger, "DBG SX1278::onValidHeader size: _ cr: _", unsigned(mRxArmedHeader.size), unsigned(mRxArmedHeader.codingRate));
+    }
+
+    // RX stopped between a valid header and its RX done, the next frame must not inherit
+    // the header. Called with mFifoMutex held.
+    void disarmRx()
+    {
+        if (mRxArmed.exchange(false, std::memory_order_acq_rel))
+        {
+            mRxArmedFrame.release();
+        }
+    }
+
+    void onRxDone(uint32_t pTick)
+    {
+        Logless(mLogger, "DBG SX1278::onRxDone RX DONE \\");
+        // 4.1.6.  LoRaTM Modem State Machine Sequences - SX1276/77/78/79 DATASHEET
+        // RegFifoAddrPtr..RegPktRssiValue are contiguous, get the packet status in one burst
+        uint8_t status[REGPKTRSSIVALUE-REGFIFOADDRPTR+1];
+        readRegisters(REGFIFOADDRPTR, status, sizeof(status));
+        auto statusOf = [&status](uint8_t pReg) {return status[pReg-REGFIFOADDRPTR];};
+
+        RxMetadata metadata = getRxMetadata(status);
+        metadata.tick = pTick;
+        metadata.timestamp = getTickTime(pTick);
+        uint8_t currRx = statusOf(REGFIFORXCURRENTADDR);
+        // RegRxNbBytes comes with the burst but is only meaningful with an explicit header
+        if (mImplicitLength)
+        {
+            metadata.size = mImplicitLength;
+        }
+        uint8_t rcvSz = metadata.size;
+
+        // Point the FIFO to the received packet and clear the IRQ flags in one burst,
+        // RegFifoTxBaseAdd..RegIrqFlagsMask are written back as read and RegFifoRxCurrentAddr is read-only.
+        status[REGFIFOADDRPTR-REGFIFOADDRPTR] = currRx;
+        writeRegisters(REGFIFOADDRPTR, status, REGIRQFLAGS-REGFIFOADDRPTR+1);
+        resetHop();
+
+        if (!(metadata.irqFlags & RXDONEMASK))
+        {
+            Logless(mLogger, "ERR SX1278::onRxDone FALSE RX irq:_", unsigned(metadata.irqFlags));
+            return;
+        }
+
+        // Corrupted payload is left in the FIFO, the reserved slot goes back to the pool
+        if (metadata.irqFlags & PAYLOADCRCERRORMASK)
+        {
+            if (mRxArmed.exchange(false, std::memory_order_acq_rel))
+            {
+                mRxArmedFrame.release();
+            }
+            Logless(mLogger, "WRN SX1278::onRxDone RX CRC ERROR! count: _", ++mRxCrcErrorCount);
+            return;
+        }
+        mRxFrameCount++;
+
+        Logless(mLogger, "DBG SX1278::onRxDone FIFO AT: _ size: _ snr: _ rssi: _", unsigned(currRx), unsigned(rcvSz), int(metadata.snr), int(metadata.rssi));
+
+        RxFrame frame;
+        if (mRxArmed.exchange(false, std::memory_order_acq_rel))
+        {
+            frame = std::move(mRxArmedFrame);
+            metadata.header = mRxArmedHeader;
         }
         else
         {
+            frame = mRxPool.acquire();
+        }
+
+        if (!frame)
+        {
+            Logless(mLogger, "ERR SX1278::onRxDone RX POOL EXHAUSTED! dropped: _", ++mRxPoolDropCount);
+            return;
+        }
+
+        // FIFO address pointer wraps around the 256 bytes data buffer
+        uint8_t wro[257];
+        wro[0] = REGFIFO;
+        mSpi.xfer(wro, frame->raw+RxFrameSlot::HEADROOM, 1+rcvSz);
+        frame->size = rcvSz;
+        frame->metadata = metadata;
+
+        mRxQueue.push(frame.detach(), [this](size_t pDropped){
+                Logless(mLogger, "WRN SX1278::onRxDone RX QUEUE FULL! dropped: _", getRxDropCount());
+                mRxPool.adopt(pDropped);
+            });
+        Logless(mLogger, "DBG SX1278::onRxDone RX DONE /");
+    }
+
+    void resumeAfterRx()
+    {
+        // Half-duplex: a deferred frame goes out now, otherwise RX is restarted so the next
+        // reception is written from the RX base again and stays out of the TX half
+        if (mTxDeferred.exchange(0))
+        {
+            startTurnaroundTx();
+            return;
+        }
+        standby();
+        setMode(Mode::RXCONTINUOUS);
+    }
+
+    void onDio1(uint32_t pTick)
+    {
+        if (Usage::TRX == mUsage)
+        {
+            onTrxDio1(pTick);
+        }
+        else if (isRx())
+        {
+            std::lock_guard<std::mutex> lock(mFifoMutex);
+            onRxDone(pTick);
+            if (Usage::TRX == mUsage)
             {
-                std::unique_lock<std::mutex> lock(mTxDoneMutex);
-                mTxDone = true;
-                setRegister(REGIRQFLAGS, TXDONEMASK);
+                resumeAfterRx();
+            }
+        }
+        else if (mTxCad)
+        {
+            onCadDone(pTick);
+        }
+        else
+        {
+            setRegister(REGIRQFLAGS, TXDONEMASK);
+            if (!completeTx(TxStatus::SENT, pTick))
+            {
+                Logless(mLogger, "ERR SX1278::onDio1 FALSE TX DONE");
+                return;
             }
             Logless(mLogger, "DBG SX1278::onDio1 TX DONE!");
-            mRxTxDoneCv.notify_one();
+            kickTx();
+        }
+    }
+
+    void onTrxDio1(uint32_t pTick)
+    {
+        // Half-duplex: the edge is served from the flags raised, an RX done edge can be served
+        // late, after the turn to TX, and must not complete the frame on air
+        uint8_t flags;
+        {
+            std::lock_guard<std::mutex> lock(mFifoMutex);
+            flags = getRegister(REGIRQFLAGS);
+            if (flags & RXDONEMASK)
+            {
+                onRxDone(pTick);
+                if (!mTrxTx)
+                {
+                    resumeAfterRx();
+                }
+            }
+        }
+
+        if (!mTrxTx)
+        {
+            return;
+        }
+        if (mTxCad && (flags & CADDONEMASK))
+        {
+            onCadDone(pTick);
+        }
+        else if (flags & TXDONEMASK)
+        {
+            setRegister(REGIRQFLAGS, TXDONEMASK);
+            if (!completeTx(TxStatus::SENT, pTick))
+            {
+                Logless(mLogger, "ERR SX1278::onTrxDio1 FALSE TX DONE");
+                return;
+            }
+            Logless(mLogger, "DBG SX1278::onTrxDio1 TX DONE!");
+            kickTx();
         }
     }
 
-    bool mTeardown = false;
-    std::mutex bufferQueueMutex;
-    std::deque<bfc::Buffer> bufferQueue;
+    std::atomic_bool mTeardown{};
+    RxFramePool mRxPool;
+    BoundedQueue<size_t> mRxQueue;
+    std::atomic<size_t> mRxPoolDropCount{};
+    std::atomic<size_t> mRxFrameCount{};
+    std::atomic<size_t> mRxCrcErrorCount{};
+    std::atomic<size_t> mRxTimeoutCount{};
+    std::chrono::microseconds mRxWindowPeriod{};
+    std::atomic<std::chrono::steady_clock::time_point> mRxWindowNext{};
+    RxFrame mRxArmedFrame;
+    RxHeader mRxArmedHeader{};
+    std::atomic_bool mRxArmed{};
 
-    std::condition_variable mRxTxDoneCv{};
-    std::mutex mTxDoneMutex;
-    bool mTxDone{};
+    TxFramePool mTxPool;
+    BoundedQueue<size_t> mTxQueue;
+    BoundedQueue<uint64_t> mIrqQueue;
+    TxFrame mTxInFlight;
+    std::atomic<TxHandle> mTxInFlightHandle{};
+    TxHandle mTxNextHandle = 1;
+    std::atomic_bool mTxBusy{};
+    std::atomic_bool mTxCad{};
+    std::atomic_bool mTxPaused{};
+    std::atomic_bool mTrxTx{};
+    std::atomic<TxHandle> mTxDeferred{};
+    std::mutex mFifoMutex;
+    bool mTxWarm{};
+    std::atomic<int64_t> mTxLatencyTotal{};
+    std::atomic<size_t> mTxSentCount{};
+    unsigned mTxCadAttempts{};
+    std::chrono::microseconds mLbtWindow{};
+    std::chrono::microseconds mLbtMaxWindow{};
+    unsigned mLbtMaxAttempts{};
+    std::minstd_rand mLbtRandom{std::random_device{}()};
+    std::atomic<size_t> mCadCount{};
+    std::atomic<size_t> mCadBusyCount{};
+    std::vector<std::array<uint8_t, 3>> mHopTable;
+    uint8_t mImplicitLength{};
+    std::atomic<size_t> mHopIndex{};
+    std::atomic<uint32_t> mTickOffset{};    // gpio tick to steady clock, see getTickTime
+    EventFd mTxSpace;
     bool mLastPacketAddr;
 
-    uint8_t mFrLsb;
-    uint8_t mFrMid;
-    uint8_t mFrMsb;
-    uint8_t mModemConfig1;
-    uint8_t mModemConfig2;
-    uint8_t mModemConfig3;
-    uint8_t mPaConfig;
+    uint8_t mShadow[REGISTER_COUNT]{};
+    std::bitset<REGISTER_COUNT> mValid;
+    std::bitset<REGISTER_COUNT> mDirty;
+    std::bitset<REGISTER_COUNT> mConfigured;
 
     uint32_t mFosc = 32000000ul;
     unsigned mResetPin{};
     unsigned mDio1Pin{};
     int mDio1CbId{};
+    int mDio3Pin;
+    int mDio3CbId{};
+    int mRxTimeoutPin;
+    int mRxTimeoutCbId{};
     Usage mUsage{};
+    IrqMode mIrqMode;
+    std::thread mIrqThread;
 
     hwapi::ISpi& mSpi;
     hwapi::IGpio& mGpio;
     Logger& mLogger;
+    Timer mTxWatchdog;
+    Timer mRxWindowTimer;
 };
 
 } // flylora_sx127x
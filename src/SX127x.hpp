@@ -1,6 +1,8 @@
 #ifndef __SX127x_HPP__
 #define __SX127x_HPP__
 
+#include <cstdint>
+
 namespace flylora_sx127x
 {
 
@@ -111,7 +113,7 @@ enum class PaRamp                     // Rise/Fall time of ramp up/down in FS
     RAMP_10_US,                    // 10 us
 };
 
-// RegPaRamp    0x0B
+// RegOcp       0x0B
 constexpr uint8_t REGOCP                 = 0x0B;
 constexpr uint8_t OCPONMASK                 = 0b00100000; // OcpOn
 constexpr uint8_t OCPTRIMMASK               = 0b00011111; // OcpTrim
@@ -147,7 +149,7 @@ enum class LnaBoostLf                 // Low Frequency (RFI_LF) LNA current adju
 enum class LnaBoostHf                 // High Frequency (RFI_HF) LNA current adjustment
 {
     DEFAULT,                    // Default LNA current
-    BOOST_ON                    // Boost on, 150% LNA current
+    BOOST_ON = 0b11             // Boost on, 150% LNA current
 };
 
 
@@ -231,9 +233,9 @@ inline double convertRssiValueToRssi(bool isHF, uint8_t rssi)
 
 // RegHopChannel                0x1C
 constexpr uint8_t REGHOPCHANNEL             = 0x1C;
-constexpr uint8_t PLLTIMEOUTMASK            = 0b00000001; // PLL failed to lock while attempting a TX/RX/CAD operation
-constexpr uint8_t CRCONPAYLOADMASK          = 0b00000001; // CRC Information extracted from the received packet header (Explicit header mode only)
-constexpr uint8_t FHSSPRESENTCHANNELMASK    = 0b00011111; // Current value of frequency hopping channel in use
+constexpr uint8_t PLLTIMEOUTMASK            = 0b10000000; // PLL failed to lock while attempting a TX/RX/CAD operation
+constexpr uint8_t CRCONPAYLOADMASK          = 0b01000000; // CRC Information extracted from the received packet header (Explicit header mode only)
+constexpr uint8_t FHSSPRESENTCHANNELMASK    = 0b00111111; // Current value of frequency hopping channel in use
 
 
 // RegModemConfig1              0x1D
@@ -283,7 +285,7 @@ enum class SpreadingFactor
 };
 
 // RegSymbTimeoutLsb            0x1F
-constexpr uint8_t REGSYMBTIMEOUTLSB         = 0x1F; // SymbTimeout MSB
+constexpr uint8_t REGSYMBTIMEOUTLSB         = 0x1F; // SymbTimeout LSB
 
 inline double convertSymbTimeoutToTimeout(double ts, uint16_t symbTimeout)
 {
@@ -309,6 +311,46 @@ constexpr uint8_t REGMODEMCONFIG3           = 0x26;
 constexpr uint8_t LOWDATARATEOPTIMIZEMASK   = 0b00001000; // LowDataRateOptimize
 constexpr uint8_t AGCAUTOONMASK             = 0b00000100; // AgcAutoOn
 
+// 4.1.1.  Link Design Using the LoRa Modem - SX1276/77/78/79 DATASHEET
+constexpr double convertBwToHz(Bw pBw)
+{
+    constexpr double bwHz[] = {7812.5, 10417, 15625, 20833, 31250, 41667, 62500, 125000, 250000, 500000};
+    return bwHz[int(pBw)];
+}
+
+constexpr uint32_t divideCeil(int32_t pNum, int32_t pDen)
+{
+    return pNum <= 0 ? 0 : (pNum+pDen-1)/pDen;
+}
+
+// 4.1.1.6. Payload Length / 4.1.1.7. Time on air - SX1276/77/78/79 DATASHEET
+// Symbol count in quarter symbols, the preamble adds 4.25 symbols
+constexpr uint32_t getPacketQuarterSymbols(SpreadingFactor pSf, CodingRate pCr, uint16_t pPreambleLength,
+    bool pImplicitHeader, bool pCrcOn, bool pLowDataRateOptimize, uint8_t pPayloadLength)
+{
+    int32_t sf = int32_t(pSf);
+    uint32_t payloadSymbols = 8 + divideCeil(
+            8*pPayloadLength - 4*sf + 28 + 16*pCrcOn - 20*pImplicitHeader,
+            4*(sf - 2*pLowDataRateOptimize)) * (int32_t(pCr) + 4);
+    return (pPreambleLength*4 + 17) + payloadSymbols*4;
+}
+
+constexpr double getSymbolTimeUs(Bw pBw, SpreadingFactor pSf)
+{
+    return (uint32_t(1) << int(pSf)) * 1000000.0 / convertBwToHz(pBw);
+}
+
+constexpr uint64_t getTimeOnAirUs(Bw pBw, SpreadingFactor pSf, CodingRate pCr, uint16_t pPreambleLength,
+    bool pImplicitHeader, bool pCrcOn, bool pLowDataRateOptimize, uint8_t pPayloadLength)
+{
+    double symbolUs = getSymbolTimeUs(pBw, pSf);
+    double quarterSymbols = getPacketQuarterSymbols(pSf, pCr, pPreambleLength, pImplicitHeader, pCrcOn, pLowDataRateOptimize, pPayloadLength);
+    return uint64_t(quarterSymbols*symbolUs/4 + 0.5);
+}
+
+static_assert(41216 == getTimeOnAirUs(Bw::BW_125_KHZ, SpreadingFactor::SF_7, CodingRate::CR_4V5, 8, false, true, false, 10), "SF7 125kHz ToA");
+static_assert(991232 == getTimeOnAirUs(Bw::BW_125_KHZ, SpreadingFactor::SF_12, CodingRate::CR_4V5, 8, false, true, true, 10), "SF12 125kHz LDRO ToA");
+
 // RegPpmCorrection             0x27
 constexpr uint8_t REGPPMCORRECTION          = 0x27; // Data rate offset value, used in conjunction with AFC
 
@@ -556,19 +598,91 @@ inline const char* regIndexToString(uint8_t pReg)
     }
 }
 
-inline uint64_t getUnmasked(uint64_t mask, uint64_t value)
+constexpr unsigned getMaskShift(uint64_t mask)
+{
+    return mask ? __builtin_ctzll(mask) : 0;
+}
+
+constexpr unsigned getMaskWidth(uint64_t mask)
+{
+    return __builtin_popcountll(mask);
+}
+
+constexpr bool isContiguousMask(uint64_t mask)
+{
+    uint64_t bits = mask>>getMaskShift(mask);
+    return !(bits & (bits+1));
+}
+
+constexpr uint64_t getUnmasked(uint64_t mask, uint64_t value)
 {
-    for (; !(mask&1); mask = (mask>>1), value = (value>>1));
-    return mask&value;
+    return (value&mask)>>getMaskShift(mask);
 }
 
-inline uint64_t setMasked(uint64_t mask, uint64_t value)
+constexpr uint64_t setMasked(uint64_t mask, uint64_t value)
 {
-    auto omask = mask;
-    for (; !(mask&1); mask = (mask>>1), value = (value<<1));
-    return value&omask;
+    return (value<<getMaskShift(mask))&mask;
 }
 
+// Register field, shift and width are derived from the mask at compile time
+template <uint8_t Mask>
+struct RegisterField
+{
+    static_assert(Mask, "empty field");
+    static_assert(isContiguousMask(Mask), "field bits must be contiguous");
+
+    static constexpr uint8_t mask = Mask;
+    static constexpr unsigned shift = getMaskShift(Mask);
+    static constexpr unsigned width = getMaskWidth(Mask);
+
+    static constexpr uint8_t set(unsigned pValue)
+    {
+        return (pValue<<shift)&mask;
+    }
+
+    static constexpr unsigned get(uint8_t pRegister)
+    {
+        return (pRegister&mask)>>shift;
+    }
+};
+
+// Register layout, its fields can't overlap. compose() takes one value per field in
+// declaration order so whole register images can be built as constants.
+template <typename... Fields>
+struct RegisterLayout
+{
+    static_assert((0 + ... + Fields::width) == getMaskWidth((0 | ... | Fields::mask)), "overlapping fields");
+
+    static constexpr uint8_t mask = (0 | ... | Fields::mask);
+
+    template <typename... Values>
+    static constexpr uint8_t compose(Values... pValues)
+    {
+        static_assert(sizeof...(Values) == sizeof...(Fields), "one value per field");
+        return (0 | ... | Fields::set(unsigned(pValues)));
+    }
+};
+
+// 6.4.    LoRa Mode Register Map - SX1276/77/78/79 DATASHEET
+using OpModeRegister       = RegisterLayout<RegisterField<LONGRANGEMODEMASK>, RegisterField<ACCESSSHAREDREGMASK>, RegisterField<LOWFREQUENCYMODEONMASK>, RegisterField<MODEMASK>>;
+using PaConfigRegister     = RegisterLayout<RegisterField<PASELECTMASK>, RegisterField<MAXPOWERMASK>, RegisterField<OUTPUTPOWERMASK>>;
+using OcpRegister          = RegisterLayout<RegisterField<OCPONMASK>, RegisterField<OCPTRIMMASK>>;
+using LnaRegister          = RegisterLayout<RegisterField<LNAGAINMASK>, RegisterField<LNABOOSTLFMASK>, RegisterField<LNABOOSTHFMASK>>;
+using ModemConfig1Register = RegisterLayout<RegisterField<BWMASK>, RegisterField<CODINGRATEMASK>, RegisterField<IMPLICITHEADERMODEONMASK>>;
+using ModemConfig2Register = RegisterLayout<RegisterField<SPREADINGFACTORMASK>, RegisterField<TXCONTINOUSMODEMASK>, RegisterField<RXPAYLOADCRCONMASK>, RegisterField<SYMBTIMEOUTMSBMASK>>;
+using ModemConfig3Register = RegisterLayout<RegisterField<LOWDATARATEOPTIMIZEMASK>, RegisterField<AGCAUTOONMASK>>;
+
+// Reset values
+constexpr uint8_t MODEMCONFIG1RESET = ModemConfig1Register::compose(Bw::BW_125_KHZ, CodingRate::CR_4V5, 0);
+constexpr uint8_t MODEMCONFIG2RESET = ModemConfig2Register::compose(SpreadingFactor::SF_7, 0, 0, 0);
+constexpr uint8_t LNARESET          = LnaRegister::compose(LnaGain::G1, LnaBoostLf::DEFAULT, LnaBoostHf::DEFAULT);
+
+static_assert(0x72 == MODEMCONFIG1RESET, "RegModemConfig1 reset value");
+static_assert(0x70 == MODEMCONFIG2RESET, "RegModemConfig2 reset value");
+static_assert(0x20 == LNARESET, "RegLna reset value");
+static_assert(0x8B == OpModeRegister::compose(1, 0, 1, Mode::TX), "LoRa TX mode");
+static_assert(RegisterField<BWMASK>::shift == 4 && RegisterField<BWMASK>::width == 4, "Bw field");
+
 }
 
 #endif // __SX127x_HPP__
\ No newline at end of file
@@ -0,0 +1,98 @@
+#ifndef __TIMER_HPP__
+#define __TIMER_HPP__
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+namespace flylora_sx127x
+{
+
+// One shot timer running on its own thread, scheduling replaces the pending expiry
+class Timer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Timer()
+        : mThread(&Timer::run, this)
+    {}
+
+    ~Timer()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mTeardown = true;
+        }
+        mCv.notify_one();
+        mThread.join();
+    }
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+    void schedule(Clock::time_point pDeadline, std::function<void()> pFn)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mDeadline = pDeadline;
+            mFn = std::move(pFn);
+        }
+        mCv.notify_one();
+    }
+
+    // Waits for a running callback, which may have scheduled again, unless called from it
+    void cancel()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (std::this_thread::get_id() != mThread.get_id())
+        {
+            mDoneCv.wait(lock, [this](){return !mRunning;});
+        }
+        mFn = nullptr;
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!mTeardown)
+        {
+            if (!mFn)
+            {
+                mCv.wait(lock);
+                continue;
+            }
+
+            if (Clock::now() < mDeadline)
+            {
+                mCv.wait_until(lock, mDeadline);
+                continue;
+            }
+
+            auto fn = std::move(mFn);
+            mFn = nullptr;
+            mRunning = true;
+            lock.unlock();
+            fn();
+            lock.lock();
+            mRunning = false;
+            mDoneCv.notify_all();
+        }
+    }
+
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    std::condition_variable mDoneCv;
+    Clock::time_point mDeadline;
+    std::function<void()> mFn;
+    bool mTeardown = false;
+    bool mRunning = false;
+    std::thread mThread;
+};
+
+} // flylora_sx127x
+
+#endif // __TIMER_HPP__
\ No newline at end of file
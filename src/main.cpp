@@ -2,6 +2,8 @@
 #include <iostream>
 #include <memory>
 #include <regex>
+#include <thread>
+#include <vector>
 #include <logless/Logger.hpp>
 #include <SX1278.hpp>
 #include <hwapi/HwApi.hpp>
@@ -41,6 +43,51 @@ int main(int argc, const char* argv[])
     std::unique_ptr<bfc::IUdpFactory> udpFactory = std::make_unique<bfc::UdpFactory>();
     app::Args args(options);
     hwapi::setup();
-    app::App app(*udpFactory, args);
-    return app.run();
+
+    int radios = args.getRadioCount();
+    if (1 == radios)
+    {
+        app::App app(*udpFactory, args);
+        return app.run();
+    }
+
+    // Multi-radio: one App per module, each configured from its --radioN.* options
+    // and running on its own threads, the SPI channels and GPIO are shared by the process
+    std::vector<std::unique_ptr<app::Args>> radioArgs;
+    std::vector<std::unique_ptr<app::App>> apps;
+    for (int i=0; i<radios; i++)
+    {
+        radioArgs.emplace_back(std::make_unique<app::Args>(options, i));
+        apps.emplace_back(std::make_unique<app::App>(*udpFactory, *radioArgs.back()));
+    }
+
+    // A failing radio doesn't take the others down, the process exits nonzero once all are done
+    std::vector<int> results(radios, 0);
+    std::vector<std::thread> runners;
+    for (int i=0; i<radios; i++)
+    {
+        runners.emplace_back([&apps, &results, i](){
+                try
+                {
+                    results[i] = apps[i]->run();
+                }
+                catch (std::exception& e)
+                {
+                    std::cerr << "radio" << i << ": " << e.what() << std::endl;
+                    results[i] = 1;
+                }
+            });
+    }
+    for (auto& runner : runners)
+    {
+        runner.join();
+    }
+    for (int result : results)
+    {
+        if (result)
+        {
+            return result;
+        }
+    }
+    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <BoundedQueue.hpp>
+#include <FramePool.hpp>
+
+using namespace ::testing;
+using namespace flylora_sx127x;
+
+TEST(BoundedQueueTests, shouldPopInOrder)
+{
+    BoundedQueue<size_t> queue(4, OverflowPolicy::DROP_OLDEST);
+    size_t value;
+    EXPECT_FALSE(queue.pop(value));
+
+    queue.push(1, [](size_t){FAIL();});
+    queue.push(2, [](size_t){FAIL();});
+    ASSERT_TRUE(queue.pop(value));
+    EXPECT_EQ(1u, value);
+    ASSERT_TRUE(queue.pop(value));
+    EXPECT_EQ(2u, value);
+    EXPECT_FALSE(queue.pop(value));
+}
+
+TEST(BoundedQueueTests, shouldDropOldest)
+{
+    BoundedQueue<size_t> queue(2, OverflowPolicy::DROP_OLDEST);
+    std::vector<size_t> dropped;
+    for (size_t i=0; i<4; i++)
+    {
+        queue.push(i, [&dropped](size_t pDropped){dropped.push_back(pDropped);});
+    }
+
+    EXPECT_EQ((std::vector<size_t>{0, 1}), dropped);
+    EXPECT_EQ(2u, queue.getDropCount());
+
+    size_t value;
+    ASSERT_TRUE(queue.pop(value));
+    EXPECT_EQ(2u, value);
+    ASSERT_TRUE(queue.pop(value));
+    EXPECT_EQ(3u, value);
+}
+
+TEST(BoundedQueueTests, shouldDropNewest)
+{
+    BoundedQueue<size_t> queue(2, OverflowPolicy::DROP_NEWEST);
+    std::vector<size_t> dropped;
+    for (size_t i=0; i<4; i++)
+    {
+        queue.push(i, [&dropped](size_t pDropped){dropped.push_back(pDropped);});
+    }
+
+    EXPECT_EQ((std::vector<size_t>{2, 3}), dropped);
+    EXPECT_EQ(2u, queue.getDropCount());
+
+    size_t value;
+    ASSERT_TRUE(queue.pop(value));
+    EXPECT_EQ(0u, value);
+    ASSERT_TRUE(queue.pop(value));
+    EXPECT_EQ(1u, value);
+}
+
+TEST(BoundedQueueTests, shouldWakeUpConsumer)
+{
+    using namespace std::chrono_literals;
+    BoundedQueue<size_t> queue(2, OverflowPolicy::DROP_OLDEST);
+    std::thread producer([&queue](){
+            std::this_thread::sleep_for(10ms);
+            queue.push(42, [](size_t){});
+        });
+
+    size_t value = 0;
+    EXPECT_TRUE(queue.pop(value, 1000ms));
+    EXPECT_EQ(42u, value);
+    producer.join();
+
+    EXPECT_FALSE(queue.pop(value, 10ms));
+}
+
+TEST(FramePoolTests, shouldReturnSlotOnRelease)
+{
+    FramePool<int> pool(2);
+    auto a = pool.acquire();
+    auto b = pool.acquire();
+    EXPECT_TRUE(a);
+    EXPECT_TRUE(b);
+    EXPECT_FALSE(pool.acquire());
+
+    auto index = a.detach();
+    EXPECT_FALSE(pool.acquire());
+    pool.adopt(index);
+    EXPECT_TRUE(pool.acquire());
+}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include <memory>
+#include <future>
 #include <SX1278.hpp>
 #include <IHwApiMock.hpp>
 #include <cstring>
@@ -43,7 +44,8 @@ struct SX1278Tests : Test
         EXPECT_CALL(mGpioMock, setMode(mResetPin, hwapi::PinMode::OUTPUT));
         EXPECT_CALL(mGpioMock, setMode(mDio1Pin, hwapi::PinMode::INPUT));
         EXPECT_CALL(mGpioMock, set(mResetPin, 1)).Times(1).RetiresOnSaturation();
-        EXPECT_CALL(mGpioMock, registerCallback(mDio1Pin, hwapi::Edge::RISING, _));
+        EXPECT_CALL(mGpioMock, registerCallback(mDio1Pin, hwapi::Edge::RISING, _))
+            .WillOnce(DoAll(SaveArg<2>(&mDio1Cb), Return(0)));
         EXPECT_CALL(mGpioMock, deregisterCallback(_));
 
         expectInit();
@@ -92,6 +94,7 @@ struct SX1278Tests : Test
 
     SpiMock mSpiMock;
     GpioMock mGpioMock;
+    std::function<void(uint32_t tick)> mDio1Cb;
     std::unique_ptr<flylora_sx127x::SX1278> mSut;
 };
 
@@ -109,6 +112,20 @@ TEST(SX1278Utils, shouldSetUnmasked)
     EXPECT_EQ(0b01101000u, setMasked(0b01111000, 0b1101));
 }
 
+TEST(SX1278Utils, shouldComposeRegisterFromFields)
+{
+    static_assert(0b00001010u == getUnmasked(0b11110000, 0b10101011), "getUnmasked is constexpr");
+    static_assert(0b01101000u == setMasked(0b01111000, 0b1101), "setMasked is constexpr");
+    static_assert(isContiguousMask(0b01110000) && !isContiguousMask(0b01010000), "contiguous masks");
+
+    constexpr uint8_t config1 = ModemConfig1Register::compose(Bw::BW_500_KHZ, CodingRate::CR_4V8, true);
+    EXPECT_EQ(0b10011001u, config1);
+    EXPECT_EQ(unsigned(Bw::BW_500_KHZ), RegisterField<BWMASK>::get(config1));
+    EXPECT_EQ(unsigned(CodingRate::CR_4V8), RegisterField<CODINGRATEMASK>::get(config1));
+    EXPECT_EQ(0xFFu, ModemConfig2Register::mask);
+    EXPECT_EQ(0b10001111u, PaConfigRegister::compose(true, 0, 0xFF));
+}
+
 TEST_F(SX1278Tests, shouldResetModule)
 {
     testing::InSequence dummy;
@@ -139,6 +156,7 @@ TEST_F(SX1278Tests, shouldSetUsageRx)
     uint8_t dio1mapping[] = { uint8_t(0x80|REGDIOMAPPING1), DIO0RXDONEMASK};
     EXPECT_CALL(mSpiMock,  xfer(isBufferEq(dio1mapping, 2), _, 2)).Times(1).RetiresOnSaturation();
     mSut->setUsage(SX1278::Usage::RXC);
+    mSut->commit();
 }
 
 TEST_F(SX1278Tests, shouldSetUsageTx)
@@ -148,26 +166,1050 @@ TEST_F(SX1278Tests, shouldSetUsageTx)
     uint8_t dio1mapping[] = { uint8_t(0x80|REGDIOMAPPING1), DIO0TXDONEMASK};
     EXPECT_CALL(mSpiMock,  xfer(isBufferEq(dio1mapping, 2), _, 2)).Times(1).RetiresOnSaturation();
     mSut->setUsage(SX1278::Usage::TX);
+    mSut->commit();
 }
 
 TEST_F(SX1278Tests, shouldSetCarrier)
 {
+    constexpr auto REGFRMSB = 6;
+    constexpr auto FOSC = 32000000ull;
+
+    constexpr auto carrier = 434000000ul;
+    constexpr auto frf = (carrier*524288ull)/FOSC;
+
+    uint8_t frfBurst[] = { uint8_t(0x80|REGFRMSB), uint8_t(frf>>16&0xFF), uint8_t(frf>>8&0xFF), uint8_t(frf&0xFF) };
+
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(frfBurst, 4), _, 4)).Times(1).RetiresOnSaturation();
+
+    mSut->setCarrier(carrier);
+    mSut->commit();
+}
+
+TEST_F(SX1278Tests, shouldGetCarrier)
+{
+    constexpr auto REGFRMSB = 6;
+    constexpr auto FOSC = 32000000ull;
+
+    constexpr auto carrier = 434000000ul;
+    constexpr auto frf = (carrier*524288ull)/FOSC;
+
+    uint8_t frfRead[] = { uint8_t(REGFRMSB), 0, 0, 0 };
+    uint8_t frfValue[] = { 0, uint8_t(frf>>16&0xFF), uint8_t(frf>>8&0xFF), uint8_t(frf&0xFF) };
+
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(frfRead, 4), _, 4))
+        .WillOnce(DoAll(SetArrayArgument<1>(frfValue, frfValue+4), Return(4)))
+        .RetiresOnSaturation();
+
+    EXPECT_EQ(carrier, mSut->getCarrier());
+}
+
+TEST_F(SX1278Tests, shouldConfigureModem)
+{
+    constexpr auto REGMODEMCONFIG1 = 0x1D;
+    constexpr auto REGMODEMCONFIG3 = 0x26;
+
+    constexpr uint8_t config1 = 0b10010010; // BW_500_KHZ, CR_4V5, explicit header
+    constexpr uint8_t config2 = 0b10110000; // SF_11
+    constexpr uint8_t config3 = 0b00001000; // LowDataRateOptimize
+
+    uint8_t config12[] = { uint8_t(0x80|REGMODEMCONFIG1), config1, config2 };
+    uint8_t config3w[] = { uint8_t(0x80|REGMODEMCONFIG3), config3 };
+
+    testing::InSequence dummy;
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(config12, 3), _, 3)).Times(1).RetiresOnSaturation();
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(config3w, 2), _, 2)).Times(1).RetiresOnSaturation();
+
+    mSut->configureModem(Bw::BW_500_KHZ, CodingRate::CR_4V5, false, SpreadingFactor::SF_11);
+    mSut->commit();
+}
+
+TEST_F(SX1278Tests, shouldCommitContiguousDirtyRegistersInOneBurst)
+{
+    constexpr auto REGFRMSB = 6;
+    constexpr auto FOSC = 32000000ull;
+
+    constexpr auto carrier = 434000000ul;
+    constexpr auto frf = (carrier*524288ull)/FOSC;
+    constexpr uint8_t paConfig = 0b01111110; // RFO, MaxPower 7, OutputPower 14
+
+    uint8_t frfPa[] = { uint8_t(0x80|REGFRMSB), uint8_t(frf>>16&0xFF), uint8_t(frf>>8&0xFF), uint8_t(frf&0xFF), paConfig };
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(frfPa, 5), _, 5)).Times(1).RetiresOnSaturation();
+
+    mSut->setCarrier(carrier);
+    mSut->setOutputPower(14);
+    mSut->commit();
+}
+
+TEST_F(SX1278Tests, shouldCommitOnlyChangedRegisters)
+{
+    constexpr auto REGFRMSB = 6;
     constexpr auto REGFRLSB = 8;
+    constexpr auto FOSC = 32000000ull;
+
+    constexpr auto carrier = 434000000ul;
+    constexpr auto frf = (carrier*524288ull)/FOSC;
+    constexpr auto frf2 = ((carrier+1000)*524288ull)/FOSC;
+    static_assert((frf>>8) == (frf2>>8), "only RegFrLsb should change");
+
+    uint8_t frfBurst[] = { uint8_t(0x80|REGFRMSB), uint8_t(frf>>16&0xFF), uint8_t(frf>>8&0xFF), uint8_t(frf&0xFF) };
+    uint8_t frfLsb[] = { uint8_t(0x80|REGFRLSB), uint8_t(frf2&0xFF) };
+
+    testing::InSequence dummy;
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(frfBurst, 4), _, 4)).Times(1).RetiresOnSaturation();
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(frfLsb, 2), _, 2)).Times(1).RetiresOnSaturation();
+
+    mSut->setCarrier(carrier);
+    mSut->commit();
+    mSut->setCarrier(carrier);
+    mSut->commit();
+    mSut->setCarrier(carrier+1000);
+    mSut->commit();
+}
+
+TEST_F(SX1278Tests, shouldEndCarrierChangeOnFrfLsb)
+{
     constexpr auto REGFRMID = 7;
+    constexpr auto FOSC = 32000000ull;
+
+    constexpr auto carrier1 = 433000000ul;
+    constexpr auto carrier2 = 434000000ul;
+    constexpr auto frf2 = (carrier2*524288ull)/FOSC;
+    static_assert(0 == (frf2&0xFF), "only RegFrMid changes");
+
+    uint8_t frfMidLsb[] = { uint8_t(0x80|REGFRMID), uint8_t(frf2>>8&0xFF), 0x00 };
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    mSut->setCarrier(carrier1);
+    mSut->commit();
+    Mock::VerifyAndClearExpectations(&mSpiMock);
+
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(frfMidLsb, 3), _, 3)).Times(1);
+
+    mSut->setCarrier(carrier2);
+    mSut->commit();
+}
+
+TEST_F(SX1278Tests, shouldReadCarrierFromShadow)
+{
+    constexpr auto carrier = 434000000ul;
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).Times(0);
+
+    mSut->setCarrier(carrier);
+    EXPECT_NEAR(carrier, mSut->getCarrier(), 62);
+}
+
+TEST_F(SX1278Tests, shouldValidateConfiguredWindowInOneBurst)
+{
     constexpr auto REGFRMSB = 6;
+    constexpr auto REGFRMID = 7;
+    constexpr auto REGFRLSB = 8;
+    constexpr auto REGVERSION = 0x42;
     constexpr auto FOSC = 32000000ull;
 
     constexpr auto carrier = 434000000ul;
     constexpr auto frf = (carrier*524288ull)/FOSC;
+    constexpr auto windowSize = REGVERSION-REGFRMSB+1;
 
+    uint8_t frfBurst[] = { uint8_t(0x80|REGFRMSB), uint8_t(frf>>16&0xFF), uint8_t(frf>>8&0xFF), uint8_t(frf&0xFF) };
     uint8_t frfLsb[] = { uint8_t(0x80|REGFRLSB), uint8_t(frf&0xFF) };
-    uint8_t frfMid[] = { uint8_t(0x80|REGFRMID), uint8_t(frf>>8&0xFF) };
-    uint8_t frfMsb[] = { uint8_t(0x80|REGFRMSB), uint8_t(frf>>16&0xFF) };
+    uint8_t windowRead[1+windowSize] = { uint8_t(REGFRMSB) };
+    uint8_t windowValue[1+windowSize] = {};
+    windowValue[1+REGFRMSB-REGFRMSB] = frf>>16&0xFF;
+    windowValue[1+REGFRMID-REGFRMSB] = frf>>8&0xFF;
+    windowValue[1+REGFRLSB-REGFRMSB] = ~frf&0xFF;
+    windowValue[1+REGVERSION-REGFRMSB] = 0x12;
 
     testing::InSequence dummy;
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(frfBurst, 4), _, 4)).Times(1).RetiresOnSaturation();
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(windowRead, 1+windowSize), _, 1+windowSize))
+        .WillOnce(DoAll(SetArrayArgument<1>(windowValue, windowValue+1+windowSize), Return(1+windowSize)))
+        .RetiresOnSaturation();
     EXPECT_CALL(mSpiMock,  xfer(isBufferEq(frfLsb, 2), _, 2)).Times(1).RetiresOnSaturation();
-    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(frfMid, 2), _, 2)).Times(1).RetiresOnSaturation();
-    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(frfMsb, 2), _, 2)).Times(1).RetiresOnSaturation();
 
     mSut->setCarrier(carrier);
+    mSut->commit();
+
+    auto validation = mSut->validate();
+    EXPECT_FALSE(validation);
+    ASSERT_EQ(1u, validation.mismatches.size());
+    EXPECT_EQ(REGFRLSB, validation.mismatches[0].reg);
+    EXPECT_EQ(uint8_t(frf&0xFF), validation.mismatches[0].expected);
+    EXPECT_EQ(uint8_t(~frf&0xFF), validation.mismatches[0].actual);
+
+    mSut->commit();
+}
+
+
+TEST_F(SX1278Tests, shouldReadRxStatusInOneBurst)
+{
+    constexpr auto REGFIFO = 0x00;
+    constexpr auto REGFIFOADDRPTR = 0x0D;
+    constexpr auto REGFIFORXCURRENTADDR = 0x10;
+    constexpr auto REGIRQFLAGS = 0x12;
+    constexpr auto REGRXNBBYTES = 0x13;
+    constexpr auto REGPKTSNRVALUE = 0x19;
+    constexpr auto REGPKTRSSIVALUE = 0x1A;
+    constexpr auto RXDONEMASK = 0b01000000;
+    constexpr auto statusSize = REGPKTRSSIVALUE-REGFIFOADDRPTR+1;
+
+    uint8_t payload[] = {'H', 'E', 'L', 'L', 'O'};
+    constexpr auto currRx = 0xFE; // wraps around the FIFO
+
+    uint8_t statusRead[1+statusSize] = { uint8_t(REGFIFOADDRPTR) };
+    uint8_t statusValue[1+statusSize] = {};
+    statusValue[1+REGFIFORXCURRENTADDR-REGFIFOADDRPTR] = currRx;
+    statusValue[1+REGIRQFLAGS-REGFIFOADDRPTR] = RXDONEMASK;
+    statusValue[1+REGRXNBBYTES-REGFIFOADDRPTR] = sizeof(payload);
+    statusValue[1+REGPKTSNRVALUE-REGFIFOADDRPTR] = uint8_t(-8);
+    statusValue[1+REGPKTRSSIVALUE-REGFIFOADDRPTR] = 100;
+
+    uint8_t statusWrite[1+REGIRQFLAGS-REGFIFOADDRPTR+1] = { uint8_t(0x80|REGFIFOADDRPTR), currRx, 0, 0, currRx, 0, RXDONEMASK };
+    uint8_t fifoRead[] = { uint8_t(REGFIFO) };
+    uint8_t fifoValue[1+sizeof(payload)] = {};
+    std::memcpy(fifoValue+1, payload, sizeof(payload));
+
+    mSut->setUsage(SX1278::Usage::RXC);
+
+    testing::InSequence dummy;
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(statusRead, 1), _, 1+statusSize))
+        .WillOnce(DoAll(SetArrayArgument<1>(statusValue, statusValue+1+statusSize), Return(1+statusSize)))
+        .RetiresOnSaturation();
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(statusWrite, sizeof(statusWrite)), _, sizeof(statusWrite))).Times(1).RetiresOnSaturation();
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(fifoRead, 1), _, 1+sizeof(payload)))
+        .WillOnce(DoAll(SetArrayArgument<1>(fifoValue, fifoValue+1+sizeof(payload)), Return(1+sizeof(payload))))
+        .RetiresOnSaturation();
+
+    mDio1Cb(0);
+
+    auto received = mSut->rx();
+    ASSERT_TRUE(received);
+    ASSERT_EQ(sizeof(payload), received->size);
+    EXPECT_EQ(0, std::memcmp(payload, received->data(), sizeof(payload)));
+    EXPECT_EQ(-2.0, received->metadata.getSnr());
+    EXPECT_EQ(-64, received->metadata.getRssi());
+}
+
+
+TEST_F(SX1278Tests, shouldChainQueuedTxOnTxDone)
+{
+    constexpr auto REGFIFO = 0x00;
+    constexpr auto REGOPMODE = 0x01;
+    constexpr auto LONGRANGEMODEMASK = 0b10000000;
+    constexpr auto LOWFREQUENCYMODEONMASK = 0b00001000;
+    constexpr auto TX = 3;
+
+    uint8_t frame1[] = {'A', 'B', 'C'};
+    uint8_t frame2[] = {'D', 'E'};
+    uint8_t fifo1[] = { uint8_t(0x80|REGFIFO), 'A', 'B', 'C' };
+    uint8_t fifo2[] = { uint8_t(0x80|REGFIFO), 'D', 'E' };
+    uint8_t txMode[] = { uint8_t(0x80|REGOPMODE), uint8_t(LONGRANGEMODEMASK|LOWFREQUENCYMODEONMASK|TX) };
+
+    mSut->setUsage(SX1278::Usage::TX);
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(fifo1, 4), _, 4)).Times(1);
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(fifo2, 3), _, 3)).Times(0);
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(txMode, 2), _, 2)).Times(1);
+
+    EXPECT_EQ(3, mSut->tx(frame1, sizeof(frame1)));
+    EXPECT_EQ(2, mSut->tx(frame2, sizeof(frame2)));
+    Mock::VerifyAndClearExpectations(&mSpiMock);
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(fifo2, 3), _, 3)).Times(1);
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(txMode, 2), _, 2)).Times(1);
+
+    mDio1Cb(0);
+    Mock::VerifyAndClearExpectations(&mSpiMock);
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(txMode, 2), _, 2)).Times(0);
+
+    mDio1Cb(0);
+}
+
+
+TEST_F(SX1278Tests, shouldNotifyTxCompletion)
+{
+    uint8_t frame1[] = {'A', 'B', 'C'};
+    uint8_t frame2[] = {'D', 'E'};
+    std::vector<TxResult> results;
+    auto onTx = [&results](const TxResult& pResult){results.push_back(pResult);};
+
+    mSut->setUsage(SX1278::Usage::TX);
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+
+    auto handle1 = mSut->submit(frame1, sizeof(frame1), onTx);
+    auto handle2 = mSut->submit(frame2, sizeof(frame2), onTx);
+    EXPECT_NE(0u, handle1);
+    EXPECT_NE(handle1, handle2);
+
+    mDio1Cb(1234);
+    ASSERT_EQ(1u, results.size());
+    EXPECT_EQ(handle1, results[0].handle);
+    EXPECT_EQ(TxStatus::SENT, results[0].status);
+    EXPECT_EQ(1234u, results[0].tick);
+
+    mSut->abortTx();
+    ASSERT_EQ(2u, results.size());
+    EXPECT_EQ(handle2, results[1].handle);
+    EXPECT_EQ(TxStatus::ABORTED, results[1].status);
+
+    mDio1Cb(1235);
+    EXPECT_EQ(2u, results.size());
+}
+
+
+TEST_F(SX1278Tests, shouldComputeTimeOnAirFromConfiguredModem)
+{
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+
+    // Reset value: BW_125_KHZ, CR_4V5, SF_7, explicit header, no CRC, preamble 8
+    EXPECT_EQ(std::chrono::microseconds(36096), mSut->getTimeOnAir(10));
+
+    mSut->configureModem(Bw::BW_125_KHZ, CodingRate::CR_4V5, false, SpreadingFactor::SF_12);
+    EXPECT_EQ(std::chrono::microseconds(991232), mSut->getTimeOnAir(10));
+}
+
+TEST_F(SX1278Tests, shouldTimeoutTxWithoutTxDone)
+{
+    uint8_t frame[] = {'A', 'B', 'C'};
+    std::promise<TxResult> result;
+    auto onTx = [&result](const TxResult& pResult){result.set_value(pResult);};
+
+    mSut->setUsage(SX1278::Usage::TX);
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+
+    auto handle = mSut->submit(frame, sizeof(frame), onTx);
+
+    auto completion = result.get_future();
+    ASSERT_EQ(std::future_status::ready, completion.wait_for(std::chrono::seconds(1)));
+    auto txResult = completion.get();
+    EXPECT_EQ(handle, txResult.handle);
+    EXPECT_EQ(TxStatus::TIMEOUT, txResult.status);
+
+    mDio1Cb(1234);
+}
+
+TEST_F(SX1278Tests, shouldPollTxDoneInIrqPollMode)
+{
+    constexpr auto REGIRQFLAGS = 0x12;
+    constexpr auto TXDONEMASK = 0b00001000;
+
+    uint8_t frame[] = {'A', 'B', 'C'};
+    uint8_t irqFlagsRead[] = { uint8_t(REGIRQFLAGS), 0 };
+    std::promise<TxResult> result;
+    auto onTx = [&result](const TxResult& pResult){result.set_value(pResult);};
+
+    EXPECT_CALL(mGpioMock, setMode(_, _)).Times(AnyNumber());
+    EXPECT_CALL(mGpioMock, set(_, _)).Times(AnyNumber());
+    EXPECT_CALL(mGpioMock, registerCallback(_, _, _)).Times(0);
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(irqFlagsRead, 1), _, 2))
+        .WillRepeatedly(Invoke([](const uint8_t*, uint8_t* pIn, unsigned){pIn[1] = TXDONEMASK; return 0;}));
+
+    SX1278 sut(mSpiMock, mGpioMock, mResetPin, mDio1Pin, 32, OverflowPolicy::DROP_OLDEST, 8, SX1278::IrqMode::POLL);
+    sut.setUsage(SX1278::Usage::TX);
+    auto handle = sut.submit(frame, sizeof(frame), onTx);
+
+    auto completion = result.get_future();
+    ASSERT_EQ(std::future_status::ready, completion.wait_for(std::chrono::seconds(1)));
+    auto txResult = completion.get();
+    EXPECT_EQ(handle, txResult.handle);
+    EXPECT_EQ(TxStatus::SENT, txResult.status);
+}
+
+TEST_F(SX1278Tests, shouldArmRxFrameOnValidHeader)
+{
+    constexpr uint8_t mDio3Pin = 3;
+    constexpr auto REGFIFO = 0x00;
+    constexpr auto REGFIFOADDRPTR = 0x0D;
+    constexpr auto REGIRQFLAGS = 0x12;
+    constexpr auto REGRXNBBYTES = 0x13;
+    constexpr auto REGMODEMSTAT = 0x18;
+    constexpr auto REGHOPCHANNEL = 0x1C;
+    constexpr auto REGPKTRSSIVALUE = 0x1A;
+    constexpr auto RXDONEMASK = 0b01000000;
+    constexpr auto VALIDHEADERMASK = 0b00010000;
+    constexpr auto CRCONPAYLOADMASK = 0b01000000;
+    constexpr auto headerSize = REGHOPCHANNEL-REGRXNBBYTES+1;
+    constexpr auto statusSize = REGPKTRSSIVALUE-REGFIFOADDRPTR+1;
+
+    std::function<void(uint32_t)> dio3Cb;
+    EXPECT_CALL(mGpioMock, setMode(_, _)).Times(AnyNumber());
+    EXPECT_CALL(mGpioMock, set(_, _)).Times(AnyNumber());
+    EXPECT_CALL(mGpioMock, registerCallback(mDio1Pin, _, _)).WillOnce(DoAll(SaveArg<2>(&mDio1Cb), Return(1)));
+    EXPECT_CALL(mGpioMock, registerCallback(mDio3Pin, _, _)).WillOnce(DoAll(SaveArg<2>(&dio3Cb), Return(2)));
+    EXPECT_CALL(mGpioMock, deregisterCallback(1));
+    EXPECT_CALL(mGpioMock, deregisterCallback(2));
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+
+    SX1278 sut(mSpiMock, mGpioMock, mResetPin, mDio1Pin, 32, OverflowPolicy::DROP_OLDEST, 8, SX1278::IrqMode::GPIO, -1, mDio3Pin);
+    sut.setUsage(SX1278::Usage::RXC);
+    Mock::VerifyAndClearExpectations(&mSpiMock);
+
+    uint8_t payload[] = {'H', 'I'};
+    uint8_t headerRead[] = { uint8_t(REGRXNBBYTES) };
+    uint8_t headerValue[1+headerSize] = {};
+    headerValue[1+REGRXNBBYTES-REGRXNBBYTES] = sizeof(payload);
+    headerValue[1+REGMODEMSTAT-REGRXNBBYTES] = uint8_t(CodingRate::CR_4V6)<<5;
+    headerValue[1+REGHOPCHANNEL-REGRXNBBYTES] = CRCONPAYLOADMASK;
+
+    uint8_t statusRead[] = { uint8_t(REGFIFOADDRPTR) };
+    uint8_t statusValue[1+statusSize] = {};
+    statusValue[1+REGIRQFLAGS-REGFIFOADDRPTR] = RXDONEMASK|VALIDHEADERMASK;
+    statusValue[1+REGRXNBBYTES-REGFIFOADDRPTR] = sizeof(payload);
+
+    uint8_t fifoRead[] = { uint8_t(REGFIFO) };
+    uint8_t fifoValue[1+sizeof(payload)] = { 0, 'H', 'I' };
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(headerRead, 1), _, 1+headerSize))
+        .WillOnce(DoAll(SetArrayArgument<1>(headerValue, headerValue+1+headerSize), Return(0)));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(statusRead, 1), _, 1+statusSize))
+        .WillOnce(DoAll(SetArrayArgument<1>(statusValue, statusValue+1+statusSize), Return(0)));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(fifoRead, 1), _, 1+sizeof(payload)))
+        .WillOnce(DoAll(SetArrayArgument<1>(fifoValue, fifoValue+1+sizeof(payload)), Return(0)));
+
+    dio3Cb(777);
+    dio3Cb(888); // served before the previous RX done, keeps the armed header
+    mDio1Cb(999);
+
+    auto received = sut.rx();
+    ASSERT_TRUE(received);
+    ASSERT_EQ(sizeof(payload), received->size);
+    EXPECT_EQ(0, std::memcmp(payload, received->data(), sizeof(payload)));
+    EXPECT_EQ(777u, received->metadata.header.tick);
+    EXPECT_EQ(sizeof(payload), received->metadata.header.size);
+    EXPECT_EQ(CodingRate::CR_4V6, received->metadata.header.codingRate);
+    EXPECT_TRUE(received->metadata.header.crcOn);
+}
+
+TEST_F(SX1278Tests, shouldDisarmRxFrameOnReconfigure)
+{
+    constexpr uint8_t mDio3Pin = 3;
+    constexpr auto REGFIFOADDRPTR = 0x0D;
+    constexpr auto REGIRQFLAGS = 0x12;
+    constexpr auto REGRXNBBYTES = 0x13;
+    constexpr auto REGHOPCHANNEL = 0x1C;
+    constexpr auto REGPKTRSSIVALUE = 0x1A;
+    constexpr auto RXDONEMASK = 0b01000000;
+    constexpr auto VALIDHEADERMASK = 0b00010000;
+    constexpr auto headerSize = REGHOPCHANNEL-REGRXNBBYTES+1;
+    constexpr auto statusSize = REGPKTRSSIVALUE-REGFIFOADDRPTR+1;
+
+    std::function<void(uint32_t)> dio3Cb;
+    EXPECT_CALL(mGpioMock, setMode(_, _)).Times(AnyNumber());
+    EXPECT_CALL(mGpioMock, set(_, _)).Times(AnyNumber());
+    EXPECT_CALL(mGpioMock, registerCallback(mDio1Pin, _, _)).WillOnce(DoAll(SaveArg<2>(&mDio1Cb), Return(1)));
+    EXPECT_CALL(mGpioMock, registerCallback(mDio3Pin, _, _)).WillOnce(DoAll(SaveArg<2>(&dio3Cb), Return(2)));
+    EXPECT_CALL(mGpioMock, deregisterCallback(1));
+    EXPECT_CALL(mGpioMock, deregisterCallback(2));
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+
+    ModemParams params{433000000, Bw::BW_125_KHZ, CodingRate::CR_4V5, SpreadingFactor::SF_7, false, 0, 8, 0x12, 10};
+    SX1278 sut(mSpiMock, mGpioMock, mResetPin, mDio1Pin, 32, OverflowPolicy::DROP_OLDEST, 8, SX1278::IrqMode::GPIO, -1, mDio3Pin);
+    sut.setUsage(SX1278::Usage::RXC);
+    sut.configure(params);
+    sut.start();
+    Mock::VerifyAndClearExpectations(&mSpiMock);
+
+    uint8_t headerRead[] = { uint8_t(REGRXNBBYTES) };
+    uint8_t headerValue[1+headerSize] = {};
+    headerValue[1+REGRXNBBYTES-REGRXNBBYTES] = 2;
+
+    uint8_t statusRead[] = { uint8_t(REGFIFOADDRPTR) };
+    uint8_t statusValue[1+statusSize] = {};
+    statusValue[1+REGIRQFLAGS-REGFIFOADDRPTR] = RXDONEMASK|VALIDHEADERMASK;
+    statusValue[1+REGRXNBBYTES-REGFIFOADDRPTR] = 2;
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(headerRead, 1), _, 1+headerSize))
+        .WillRepeatedly(DoAll(SetArrayArgument<1>(headerValue, headerValue+1+headerSize), Return(0)));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(statusRead, 1), _, 1+statusSize))
+        .WillOnce(DoAll(SetArrayArgument<1>(statusValue, statusValue+1+statusSize), Return(0)));
+
+    dio3Cb(777);
+    sut.reconfigure(params, false); // stops RX before the frame's RX done
+    dio3Cb(888);
+    mDio1Cb(999);
+
+    auto received = sut.rx();
+    ASSERT_TRUE(received);
+    EXPECT_EQ(888u, received->metadata.header.tick);
+}
+
+TEST_F(SX1278Tests, shouldDropCrcErrorWithoutReadingFifo)
+{
+    constexpr auto REGFIFO = 0x00;
+    constexpr auto REGFIFOADDRPTR = 0x0D;
+    constexpr auto REGIRQFLAGS = 0x12;
+    constexpr auto REGRXNBBYTES = 0x13;
+    constexpr auto REGPKTRSSIVALUE = 0x1A;
+    constexpr auto RXDONEMASK = 0b01000000;
+    constexpr auto PAYLOADCRCERRORMASK = 0b00100000;
+    constexpr auto statusSize = REGPKTRSSIVALUE-REGFIFOADDRPTR+1;
+
+    uint8_t statusRead[] = { uint8_t(REGFIFOADDRPTR) };
+    uint8_t statusValue[1+statusSize] = {};
+    statusValue[1+REGIRQFLAGS-REGFIFOADDRPTR] = RXDONEMASK|PAYLOADCRCERRORMASK;
+    statusValue[1+REGRXNBBYTES-REGFIFOADDRPTR] = 5;
+    uint8_t fifoRead[] = { uint8_t(REGFIFO) };
+
+    mSut->setUsage(SX1278::Usage::RXC);
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(statusRead, 1), _, 1+statusSize))
+        .WillOnce(DoAll(SetArrayArgument<1>(statusValue, statusValue+1+statusSize), Return(0)));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(fifoRead, 1), _, _)).Times(0);
+
+    mDio1Cb(0);
+
+    EXPECT_EQ(1u, mSut->getRxCrcErrorCount());
+    EXPECT_EQ(0u, mSut->getRxFrameCount());
+}
+
+TEST_F(SX1278Tests, shouldOpenRxSingleWindow)
+{
+    constexpr auto REGOPMODE = 0x01;
+    constexpr auto REGMODEMCONFIG2 = 0x1E;
+    constexpr auto LONGRANGEMODEMASK = 0b10000000;
+    constexpr auto LOWFREQUENCYMODEONMASK = 0b00001000;
+    constexpr auto RXSINGLE = 6;
+
+    uint8_t symbTimeout[] = { uint8_t(0x80|REGMODEMCONFIG2), 0x71, 0x05 }; // reset config2 with 0x105 symbols
+    uint8_t rxSingle[] = { uint8_t(0x80|REGOPMODE), uint8_t(LONGRANGEMODEMASK|LOWFREQUENCYMODEONMASK|RXSINGLE) };
+
+    mSut->setUsage(SX1278::Usage::RXS);
+    EXPECT_THROW(mSut->setRxWindow(1024, std::chrono::seconds(10)), std::runtime_error);
+    mSut->setRxWindow(0x105, std::chrono::seconds(10));
+    EXPECT_EQ(std::chrono::microseconds(267264), mSut->getRxWindowDuration());
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(symbTimeout, 3), _, 3)).Times(1);
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(rxSingle, 2), _, 2)).Times(1);
+
+    auto before = std::chrono::steady_clock::now();
+    mSut->start();
+    EXPECT_GT(mSut->getNextRxWindow(), before + std::chrono::seconds(9));
+}
+
+TEST_F(SX1278Tests, shouldBackoffTxWhileChannelIsBusy)
+{
+    constexpr auto REGOPMODE = 0x01;
+    constexpr auto REGIRQFLAGS = 0x12;
+    constexpr auto LONGRANGEMODEMASK = 0b10000000;
+    constexpr auto LOWFREQUENCYMODEONMASK = 0b00001000;
+    constexpr auto TX = 3;
+    constexpr auto CAD = 7;
+    constexpr auto CADDONEMASK = 0b00000100;
+    constexpr auto CADDETECTEDMASK = 0b00000001;
+
+    uint8_t frame[] = {'A', 'B', 'C'};
+    uint8_t irqFlagsRead[] = { uint8_t(REGIRQFLAGS) };
+    uint8_t cadMode[] = { uint8_t(0x80|REGOPMODE), uint8_t(LONGRANGEMODEMASK|LOWFREQUENCYMODEONMASK|CAD) };
+    uint8_t txMode[] = { uint8_t(0x80|REGOPMODE), uint8_t(LONGRANGEMODEMASK|LOWFREQUENCYMODEONMASK|TX) };
+    std::promise<void> cadRetried;
+    std::vector<TxResult> results;
+    auto onTx = [&results](const TxResult& pResult){results.push_back(pResult);};
+
+    mSut->setUsage(SX1278::Usage::TX);
+    mSut->setListenBeforeTalk(std::chrono::microseconds(1000), std::chrono::microseconds(4000), 3);
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(irqFlagsRead, 1), _, 2))
+        .WillOnce(Invoke([](uint8_t*, uint8_t* pIn, unsigned){pIn[1] = CADDONEMASK|CADDETECTEDMASK; return 0;}))
+        .WillOnce(Invoke([](uint8_t*, uint8_t* pIn, unsigned){pIn[1] = CADDONEMASK; return 0;}));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(cadMode, 2), _, 2))
+        .WillOnce(Return(0))
+        .WillOnce(InvokeWithoutArgs([&cadRetried](){cadRetried.set_value(); return 0;}));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(txMode, 2), _, 2)).Times(1);
+
+    auto handle = mSut->submit(frame, sizeof(frame), onTx);
+
+    mDio1Cb(1);
+    ASSERT_EQ(std::future_status::ready, cadRetried.get_future().wait_for(std::chrono::seconds(1)));
+    mDio1Cb(2);
+    mDio1Cb(3);
+
+    ASSERT_EQ(1u, results.size());
+    EXPECT_EQ(handle, results[0].handle);
+    EXPECT_EQ(TxStatus::SENT, results[0].status);
+    EXPECT_EQ(2u, mSut->getCadCount());
+    EXPECT_EQ(1u, mSut->getCadBusyCount());
+}
+
+TEST_F(SX1278Tests, shouldRejectHoppingWithoutDio1Line)
+{
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).Times(0);
+
+    EXPECT_THROW(mSut->setHopTable({433000000, 434000000}, 10), std::runtime_error);
+    mSut->setHopTable({433000000, 434000000}, 0);
+}
+
+TEST_F(SX1278Tests, shouldHopThroughTableAndRestartOnFirstChannel)
+{
+    constexpr uint8_t mDio1LinePin = 4;
+    constexpr auto REGFRMSB = 0x06;
+    constexpr auto REGIRQFLAGS = 0x12;
+    constexpr auto FHSSCHANGECHANNELMASK = 0b00000010;
+
+    std::function<void(uint32_t)> hopCb;
+    EXPECT_CALL(mGpioMock, setMode(_, _)).Times(AnyNumber());
+    EXPECT_CALL(mGpioMock, set(_, _)).Times(AnyNumber());
+    EXPECT_CALL(mGpioMock, registerCallback(mDio1Pin, _, _)).WillOnce(DoAll(SaveArg<2>(&mDio1Cb), Return(1)));
+    EXPECT_CALL(mGpioMock, registerCallback(mDio1LinePin, _, _)).WillOnce(DoAll(SaveArg<2>(&hopCb), Return(2)));
+    EXPECT_CALL(mGpioMock, deregisterCallback(1));
+    EXPECT_CALL(mGpioMock, deregisterCallback(2));
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+
+    SX1278 sut(mSpiMock, mGpioMock, mResetPin, mDio1Pin, 32, OverflowPolicy::DROP_OLDEST, 8, SX1278::IrqMode::GPIO, -1, -1, mDio1LinePin);
+    sut.setUsage(SX1278::Usage::TX);
+    sut.setHopTable({433000000, 434000000}, 10);
+    EXPECT_EQ(433000000u, sut.getCarrier());
+    sut.commit();
+    Mock::VerifyAndClearExpectations(&mSpiMock);
+
+    uint8_t channel0[] = { uint8_t(0x80|REGFRMSB), 0x6C, 0x40, 0x00 }; // 433MHz
+    uint8_t channel1[] = { uint8_t(0x80|REGFRMSB), 0x6C, 0x80, 0x00 }; // 434MHz
+    uint8_t hopClear[] = { uint8_t(0x80|REGIRQFLAGS), FHSSCHANGECHANNELMASK };
+    uint8_t frame[] = {'A'};
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    {
+        testing::InSequence dummy;
+        EXPECT_CALL(mSpiMock,  xfer(isBufferEq(channel1, 4), _, 4)).Times(1);
+        EXPECT_CALL(mSpiMock,  xfer(isBufferEq(hopClear, 2), _, 2)).Times(1);
+        EXPECT_CALL(mSpiMock,  xfer(isBufferEq(channel0, 4), _, 4)).Times(1);
+    }
+
+    sut.tx(frame, sizeof(frame));
+    hopCb(1);
+    mDio1Cb(2);
+    sut.tx(frame, sizeof(frame));
+}
+
+TEST_F(SX1278Tests, shouldPadTxToImplicitLength)
+{
+    constexpr auto REGFIFO = 0x00;
+    constexpr auto REGMODEMCONFIG1 = 0x1D;
+    constexpr auto REGPAYLOADLENGTH = 0x22;
+
+    uint8_t frame[] = {'A', 'B'};
+    uint8_t implicitConfig1[] = { uint8_t(0x80|REGMODEMCONFIG1), 0x73 }; // reset config1 with implicit header
+    uint8_t payloadLength[] = { uint8_t(0x80|REGPAYLOADLENGTH), 4 };
+    uint8_t fifo[] = { uint8_t(0x80|REGFIFO), 'A', 'B', 0, 0 };
+    uint8_t tooLong[] = {'A', 'B', 'C', 'D', 'E'};
+
+    mSut->setUsage(SX1278::Usage::TX);
+    mSut->setImplicitLength(4);
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(implicitConfig1, 2), _, 2)).Times(1);
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(payloadLength, 2), _, 2)).Times(1);
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(fifo, 5), _, 5)).Times(1);
+
+    EXPECT_NE(0u, mSut->submit(frame, sizeof(frame)));
+    EXPECT_EQ(0u, mSut->submit(tooLong, sizeof(tooLong)));
+}
+
+TEST_F(SX1278Tests, shouldRejectTxLongerThanMaxPayloadLength)
+{
+    uint8_t tooLong[300] = {};
+
+    mSut->setUsage(SX1278::Usage::TX);
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).Times(0);
+
+    EXPECT_EQ(0u, mSut->submit(tooLong, sizeof(tooLong)));
+    EXPECT_EQ(-1, mSut->tx(tooLong, 256));
+}
+
+TEST_F(SX1278Tests, shouldReadImplicitLengthOnRxDone)
+{
+    constexpr auto REGFIFO = 0x00;
+    constexpr auto REGFIFOADDRPTR = 0x0D;
+    constexpr auto REGIRQFLAGS = 0x12;
+    constexpr auto REGRXNBBYTES = 0x13;
+    constexpr auto REGPKTRSSIVALUE = 0x1A;
+    constexpr auto RXDONEMASK = 0b01000000;
+    constexpr auto statusSize = REGPKTRSSIVALUE-REGFIFOADDRPTR+1;
+
+    uint8_t statusRead[] = { uint8_t(REGFIFOADDRPTR) };
+    uint8_t statusValue[1+statusSize] = {};
+    statusValue[1+REGIRQFLAGS-REGFIFOADDRPTR] = RXDONEMASK;
+    statusValue[1+REGRXNBBYTES-REGFIFOADDRPTR] = 9; // stale, not used in implicit header mode
+    uint8_t fifoRead[] = { uint8_t(REGFIFO) };
+
+    mSut->setUsage(SX1278::Usage::RXC);
+    mSut->setImplicitLength(3);
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(statusRead, 1), _, 1+statusSize))
+        .WillOnce(DoAll(SetArrayArgument<1>(statusValue, statusValue+1+statusSize), Return(0)));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(fifoRead, 1), _, 1+3)).Times(1);
+
+    mDio1Cb(0);
+
+    auto received = mSut->rx();
+    ASSERT_TRUE(received);
+    EXPECT_EQ(3u, received->size);
+}
+
+TEST_F(SX1278Tests, shouldSetPreambleAndSyncWord)
+{
+    constexpr auto REGPREAMBLEMSB = 0x20;
+    constexpr auto REGSYNCWORD = 0x39;
+
+    uint8_t preamble[] = { uint8_t(0x80|REGPREAMBLEMSB), 0x00, 12 };
+    uint8_t syncWord[] = { uint8_t(0x80|REGSYNCWORD), 0x42 };
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(preamble, 3), _, 3)).Times(1);
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(syncWord, 2), _, 2)).Times(1);
+
+    auto toa = mSut->getTimeOnAir(10);
+    mSut->setPreambleLength(12);
+    mSut->setSyncWord(0x42);
+    mSut->commit();
+
+    // 4 more symbols of 1024us at SF7 125kHz
+    EXPECT_EQ(toa + std::chrono::microseconds(4*1024), mSut->getTimeOnAir(10));
+}
+
+TEST_F(SX1278Tests, shouldReconfigureOnlyChangedRegistersAndResumeTx)
+{
+    constexpr auto REGFIFO = 0x00;
+    constexpr auto REGMODEMCONFIG2 = 0x1E;
+    constexpr auto REGFRMSB = 0x06;
+    constexpr auto REGSYNCWORD = 0x39;
+
+    ModemParams params{433000000, Bw::BW_125_KHZ, CodingRate::CR_4V5, SpreadingFactor::SF_7, false, 0, 8, 0x12, 10};
+    uint8_t frame1[] = {'A'};
+    uint8_t frame2[] = {'B'};
+    uint8_t fifo2[] = { uint8_t(0x80|REGFIFO), 'B' };
+    uint8_t sf9[] = { uint8_t(0x80|REGMODEMCONFIG2), 0x90 };
+    uint8_t frfWrite[] = { uint8_t(0x80|REGFRMSB) };
+    uint8_t syncWordWrite[] = { uint8_t(0x80|REGSYNCWORD) };
+    std::vector<TxResult> results;
+    auto onTx = [&results](const TxResult& pResult){results.push_back(pResult);};
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    mSut->setUsage(SX1278::Usage::TX);
+    mSut->configure(params);
+    mSut->start();
+    mSut->submit(frame1, sizeof(frame1), onTx);
+    mSut->submit(frame2, sizeof(frame2), onTx);
+    Mock::VerifyAndClearExpectations(&mSpiMock);
+
+    params.spreadingFactor = SpreadingFactor::SF_9;
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(sf9, 2), _, 2)).Times(1);
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(frfWrite, 1), _, _)).Times(0);
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(syncWordWrite, 1), _, _)).Times(0);
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(fifo2, 2), _, 2)).Times(1);
+
+    mSut->reconfigure(params, true);
+
+    ASSERT_EQ(1u, results.size());
+    EXPECT_EQ(TxStatus::ABORTED, results[0].status);
+}
+
+TEST_F(SX1278Tests, shouldApplyRxFrontEndAndLeaveLnaGainToAgc)
+{
+    constexpr auto REGLNA = 0x0C;
+    constexpr auto REGMODEMCONFIG3 = 0x26;
+    constexpr auto REGVERSION = 0x42;
+    constexpr auto AGCAUTOONMASK = 0b00000100;
+    constexpr auto windowSize = REGVERSION-REGLNA+1;
+
+    uint8_t lnaWrite[] = { uint8_t(0x80|REGLNA), 0b01100011 }; // G3, HF boost
+    uint8_t config3Write[] = { uint8_t(0x80|REGMODEMCONFIG3), AGCAUTOONMASK };
+    uint8_t windowRead[1+windowSize] = { uint8_t(REGLNA) };
+    uint8_t windowValue[1+windowSize] = {};
+    windowValue[1+REGLNA-REGLNA] = 0b00100011; // G1 picked by the AGC
+    windowValue[1+REGMODEMCONFIG3-REGLNA] = AGCAUTOONMASK;
+    windowValue[1+REGVERSION-REGLNA] = 0x12;
+    uint8_t lnaRead[] = { uint8_t(REGLNA) };
+    uint8_t lnaValue[] = { 0, 0b01000011 };
+
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(lnaWrite, 2), _, 2)).Times(1);
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(config3Write, 2), _, 2)).Times(1);
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(windowRead, 1+windowSize), _, 1+windowSize))
+        .WillOnce(DoAll(SetArrayArgument<1>(windowValue, windowValue+1+windowSize), Return(1+windowSize)));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(lnaRead, 1), _, 2))
+        .WillOnce(DoAll(SetArrayArgument<1>(lnaValue, lnaValue+2), Return(2)));
+
+    mSut->setRxFrontEnd(LnaGain::G3, true, true);
+    mSut->commit();
+
+    EXPECT_TRUE(mSut->validate());
+    EXPECT_TRUE(mSut->isAgc());
+    EXPECT_EQ(LnaGain::G2, mSut->getCurrentLnaGain());
+    EXPECT_THROW(mSut->setRxFrontEnd(LnaGain(0), false, false), std::runtime_error);
+}
+
+TEST_F(SX1278Tests, shouldKeepRunningOnRejectedReconfiguration)
+{
+    constexpr auto REGFIFO = 0x00;
+
+    ModemParams params{433000000, Bw::BW_125_KHZ, CodingRate::CR_4V5, SpreadingFactor::SF_7, false, 0, 8, 0x12, 10};
+    uint8_t frame1[] = {'A'};
+    uint8_t frame2[] = {'B'};
+    uint8_t fifo2[] = { uint8_t(0x80|REGFIFO), 'B' };
+    std::vector<TxResult> results;
+    auto onTx = [&results](const TxResult& pResult){results.push_back(pResult);};
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    mSut->setUsage(SX1278::Usage::TX);
+    mSut->configure(params);
+    mSut->start();
+    mSut->submit(frame1, sizeof(frame1), onTx);
+    mSut->submit(frame2, sizeof(frame2), onTx);
+    Mock::VerifyAndClearExpectations(&mSpiMock);
+
+    params.txPower = 30;
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).Times(0);
+    EXPECT_THROW(mSut->reconfigure(params, true), std::runtime_error);
+    Mock::VerifyAndClearExpectations(&mSpiMock);
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(fifo2, 2), _, 2)).Times(1);
+
+    mDio1Cb(1000);
+
+    ASSERT_EQ(1u, results.size());
+    EXPECT_EQ(TxStatus::SENT, results[0].status);
+}
+
+TEST_F(SX1278Tests, shouldKeepSynthesizerLockedInWarmStandby)
+{
+    constexpr auto REGOPMODE = 0x01;
+    constexpr auto REGPARAMP = 0x0A;
+    constexpr auto LONGRANGEMODEMASK = 0b10000000;
+    constexpr auto LOWFREQUENCYMODEONMASK = 0b00001000;
+    constexpr auto FSTX = 2;
+    constexpr auto TX = 3;
+
+    uint8_t frame[] = {'A'};
+    uint8_t paRamp[] = { uint8_t(0x80|REGPARAMP), 0x0F }; // 10us
+    uint8_t fstxMode[] = { uint8_t(0x80|REGOPMODE), uint8_t(LONGRANGEMODEMASK|LOWFREQUENCYMODEONMASK|FSTX) };
+    uint8_t txMode[] = { uint8_t(0x80|REGOPMODE), uint8_t(LONGRANGEMODEMASK|LOWFREQUENCYMODEONMASK|TX) };
+    std::vector<TxResult> results;
+    auto onTx = [&results](const TxResult& pResult){results.push_back(pResult);};
+
+    mSut->setUsage(SX1278::Usage::TX);
+    mSut->setPaRamp(PaRamp::RAMP_10_US);
+    mSut->setWarmStandby(true);
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    {
+        testing::InSequence dummy;
+        EXPECT_CALL(mSpiMock,  xfer(isBufferEq(paRamp, 2), _, 2)).Times(1);
+        EXPECT_CALL(mSpiMock,  xfer(isBufferEq(fstxMode, 2), _, 2)).Times(2); // start, load
+        EXPECT_CALL(mSpiMock,  xfer(isBufferEq(txMode, 2), _, 2)).Times(1);
+        EXPECT_CALL(mSpiMock,  xfer(isBufferEq(fstxMode, 2), _, 2)).Times(1); // idle after TX done
+    }
+
+    mSut->start();
+    mSut->submit(frame, sizeof(frame), onTx);
+    mDio1Cb(0);
+
+    ASSERT_EQ(1u, results.size());
+    EXPECT_EQ(TxStatus::SENT, results[0].status);
+    EXPECT_GE(results[0].latency, results[0].airtime);
+}
+
+TEST_F(SX1278Tests, shouldPreloadTxBehindRxAndTurnAroundInHalfDuplex)
+{
+    constexpr auto REGOPMODE = 0x01;
+    constexpr auto REGFIFOADDRPTR = 0x0D;
+    constexpr auto REGFIFOTXBASEADD = 0x0E;
+    constexpr auto REGIRQFLAGS = 0x12;
+    constexpr auto REGMODEMSTAT = 0x18;
+    constexpr auto REGMAXPAYLOADLENGTH = 0x23;
+    constexpr auto REGDIOMAPPING1 = 0x40;
+    constexpr auto LONGRANGEMODEMASK = 0b10000000;
+    constexpr auto LOWFREQUENCYMODEONMASK = 0b00001000;
+    constexpr auto TX = 3;
+    constexpr auto RXCONTINUOUS = 5;
+    constexpr auto RXONGOINGMASK = 0b00000100;
+    constexpr auto RXDONEMASK = 0b01000000;
+    constexpr auto TXDONEMASK = 0b00001000;
+    constexpr auto DIO0TXDONEMASK = 0b01000000;
+    constexpr auto statusSize = REGMODEMSTAT-REGIRQFLAGS+1;
+
+    uint8_t frame[] = {'A', 'B'};
+    uint8_t txBase[] = { uint8_t(0x80|REGFIFOTXBASEADD), 0x80 };
+    uint8_t maxPayload[] = { uint8_t(0x80|REGMAXPAYLOADLENGTH), 0x80 };
+    uint8_t txPreload[] = { uint8_t(0x80|REGFIFOADDRPTR), 0x80 };
+    uint8_t statusRead[] = { uint8_t(REGIRQFLAGS) };
+    uint8_t txMapping[] = { uint8_t(0x80|REGDIOMAPPING1), DIO0TXDONEMASK };
+    uint8_t rxMapping[] = { uint8_t(0x80|REGDIOMAPPING1), 0 };
+    uint8_t txMode[] = { uint8_t(0x80|REGOPMODE), uint8_t(LONGRANGEMODEMASK|LOWFREQUENCYMODEONMASK|TX) };
+    uint8_t rxMode[] = { uint8_t(0x80|REGOPMODE), uint8_t(LONGRANGEMODEMASK|LOWFREQUENCYMODEONMASK|RXCONTINUOUS) };
+    std::vector<TxResult> results;
+    auto onTx = [&results](const TxResult& pResult){results.push_back(pResult);};
+
+    mSut->setUsage(SX1278::Usage::TRX);
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(txBase, 2), _, 2)).Times(1);
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(maxPayload, 2), _, 2)).Times(1);
+    {
+        testing::InSequence dummy;
+        EXPECT_CALL(mSpiMock,  xfer(isBufferEq(rxMode, 2), _, 2)).Times(1);
+        EXPECT_CALL(mSpiMock,  xfer(isBufferEq(txPreload, 2), _, 2)).Times(1);
+        EXPECT_CALL(mSpiMock,  xfer(isBufferEq(statusRead, 1), _, 1+statusSize))
+            .WillOnce(Invoke([](uint8_t*, uint8_t* pIn, unsigned){pIn[1+REGMODEMSTAT-REGIRQFLAGS] = RXONGOINGMASK; return 0;}));
+        // RX done of the ongoing reception turns around with two writes
+        EXPECT_CALL(mSpiMock,  xfer(isBufferEq(statusRead, 1), _, 2))
+            .WillOnce(Invoke([](uint8_t*, uint8_t* pIn, unsigned){pIn[1] = RXDONEMASK; return 0;}));
+        EXPECT_CALL(mSpiMock,  xfer(isBufferEq(txMapping, 2), _, 2)).Times(1);
+        EXPECT_CALL(mSpiMock,  xfer(isBufferEq(txMode, 2), _, 2)).Times(1);
+        // TX done of the last frame back to RX with two writes
+        EXPECT_CALL(mSpiMock,  xfer(isBufferEq(statusRead, 1), _, 2))
+            .WillOnce(Invoke([](uint8_t*, uint8_t* pIn, unsigned){pIn[1] = TXDONEMASK; return 0;}));
+        EXPECT_CALL(mSpiMock,  xfer(isBufferEq(rxMapping, 2), _, 2)).Times(1);
+        EXPECT_CALL(mSpiMock,  xfer(isBufferEq(rxMode, 2), _, 2)).Times(1);
+    }
+
+    mSut->start();
+    auto handle = mSut->submit(frame, sizeof(frame), onTx);
+    EXPECT_TRUE(results.empty());
+
+    mDio1Cb(1);
+    mDio1Cb(2);
+
+    ASSERT_EQ(1u, results.size());
+    EXPECT_EQ(handle, results[0].handle);
+    EXPECT_EQ(TxStatus::SENT, results[0].status);
+}
+
+TEST_F(SX1278Tests, shouldDeferTurnaroundWhileRxDoneIsPending)
+{
+    constexpr auto REGOPMODE = 0x01;
+    constexpr auto REGIRQFLAGS = 0x12;
+    constexpr auto REGMODEMSTAT = 0x18;
+    constexpr auto LONGRANGEMODEMASK = 0b10000000;
+    constexpr auto LOWFREQUENCYMODEONMASK = 0b00001000;
+    constexpr auto TX = 3;
+    constexpr auto RXDONEMASK = 0b01000000;
+    constexpr auto statusSize = REGMODEMSTAT-REGIRQFLAGS+1;
+
+    uint8_t frame[] = {'A', 'B'};
+    uint8_t statusRead[] = { uint8_t(REGIRQFLAGS) };
+    uint8_t txMode[] = { uint8_t(0x80|REGOPMODE), uint8_t(LONGRANGEMODEMASK|LOWFREQUENCYMODEONMASK|TX) };
+    std::vector<TxResult> results;
+    auto onTx = [&results](const TxResult& pResult){results.push_back(pResult);};
+
+    mSut->setUsage(SX1278::Usage::TRX);
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    mSut->start();
+    Mock::VerifyAndClearExpectations(&mSpiMock);
+
+    // Reception ended, RxDone raised but its edge not served yet
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(txMode, 2), _, 2)).Times(0);
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(statusRead, 1), _, 1+statusSize))
+        .WillOnce(Invoke([](uint8_t*, uint8_t* pIn, unsigned){pIn[1] = RXDONEMASK; return 0;}));
+    auto handle = mSut->submit(frame, sizeof(frame), onTx);
+    Mock::VerifyAndClearExpectations(&mSpiMock);
+
+    // The late RX done edge is served as RX, then the deferred frame goes out
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(statusRead, 1), _, 2))
+        .WillOnce(Invoke([](uint8_t*, uint8_t* pIn, unsigned){pIn[1] = RXDONEMASK; return 0;}));
+    EXPECT_CALL(mSpiMock,  xfer(isBufferEq(txMode, 2), _, 2)).Times(1);
+    mDio1Cb(1);
+
+    EXPECT_TRUE(results.empty());
+    EXPECT_NE(0u, handle);
+}
+
+TEST_F(SX1278Tests, shouldRejectTxLongerThanHalfDuplexMtu)
+{
+    uint8_t frame[SX1278::HALF_DUPLEX_MTU+1] = {};
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    mSut->setUsage(SX1278::Usage::TRX);
+    EXPECT_EQ(0u, mSut->submit(frame, sizeof(frame)));
+    EXPECT_THROW(mSut->setImplicitLength(SX1278::HALF_DUPLEX_MTU+1), std::runtime_error);
+}
+
+TEST_F(SX1278Tests, shouldServeTxDoneOnIrqWorkerThread)
+{
+    uint8_t frame[] = {'A', 'B', 'C'};
+    std::function<void(uint32_t)> txDoneCb;
+    std::promise<std::pair<TxResult, std::thread::id>> result;
+    auto onTx = [&result](const TxResult& pResult){result.set_value({pResult, std::this_thread::get_id()});};
+
+    EXPECT_CALL(mGpioMock, setMode(_, _)).Times(AnyNumber());
+    EXPECT_CALL(mGpioMock, set(_, _)).Times(AnyNumber());
+    EXPECT_CALL(mGpioMock, registerCallback(mDio1Pin, _, _)).WillOnce(DoAll(SaveArg<2>(&txDoneCb), Return(1)));
+    EXPECT_CALL(mGpioMock, deregisterCallback(1));
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+
+    SX1278 sut(mSpiMock, mGpioMock, mResetPin, mDio1Pin, 32, OverflowPolicy::DROP_OLDEST, 8, SX1278::IrqMode::THREAD);
+    sut.setUsage(SX1278::Usage::TX);
+    auto handle = sut.submit(frame, sizeof(frame), onTx);
+
+    // The gpio callback only posts the edge
+    txDoneCb(4321);
+
+    auto completion = result.get_future();
+    ASSERT_EQ(std::future_status::ready, completion.wait_for(std::chrono::seconds(1)));
+    auto txResult = completion.get();
+    EXPECT_EQ(handle, txResult.first.handle);
+    EXPECT_EQ(TxStatus::SENT, txResult.first.status);
+    EXPECT_EQ(4321u, txResult.first.tick);
+    EXPECT_NE(std::this_thread::get_id(), txResult.second);
+}
+
+TEST_F(SX1278Tests, shouldTimestampTxDoneFromGpioTick)
+{
+    uint8_t frame[] = {'A'};
+    std::vector<TxResult> results;
+    auto onTx = [&results](const TxResult& pResult){results.push_back(pResult);};
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    mSut->setUsage(SX1278::Usage::TX);
+    mSut->submit(frame, sizeof(frame), onTx);
+
+    // TX done edge 100us before it is served
+    auto edge = std::chrono::steady_clock::now() - std::chrono::microseconds(100);
+    auto tick = uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(edge.time_since_epoch()).count());
+    mDio1Cb(tick);
+
+    ASSERT_EQ(1u, results.size());
+    EXPECT_EQ(tick, results[0].tick);
+    EXPECT_LE(std::chrono::abs(results[0].timestamp - edge), std::chrono::microseconds(1));
+}
+
+TEST_F(SX1278Tests, shouldCalibrateGpioTickOfAnotherTimeBase)
+{
+    constexpr uint32_t tickEpoch = 0xF0000000; // gpio tick counts from another epoch
+    uint8_t frame1[] = {'A'};
+    uint8_t frame2[] = {'B'};
+    std::vector<TxResult> results;
+    auto onTx = [&results](const TxResult& pResult){results.push_back(pResult);};
+    auto toTick = [](std::chrono::steady_clock::time_point pTime) {
+            return uint32_t(tickEpoch+std::chrono::duration_cast<std::chrono::microseconds>(pTime.time_since_epoch()).count());
+        };
+
+    EXPECT_CALL(mSpiMock,  xfer(_, _, _)).WillRepeatedly(Return(0));
+    mSut->setUsage(SX1278::Usage::TX);
+    mSut->submit(frame1, sizeof(frame1), onTx);
+    mSut->submit(frame2, sizeof(frame2), onTx);
+
+    // First edge served right away calibrates the offset
+    mDio1Cb(toTick(std::chrono::steady_clock::now()));
+
+    // TX done edge 300us before it is served
+    auto edge = std::chrono::steady_clock::now() - std::chrono::microseconds(300);
+    mDio1Cb(toTick(edge));
+
+    ASSERT_EQ(2u, results.size());
+    EXPECT_LE(std::chrono::abs(results[1].timestamp - edge), std::chrono::microseconds(50));
 }
\ No newline at end of file